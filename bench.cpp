@@ -0,0 +1,99 @@
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <png_decoder.h>
+
+#ifndef TASK_DIR
+#define TASK_DIR "."
+#endif
+
+// Decodes the same corpus with every inflate backend available in this build and reports the throughput
+// in MB of PNG files decoded per second.
+// Usage: bench_png_decoder [iterations] [files...], by default the valid images from `tests/` are used.
+
+namespace {
+
+const std::vector<std::string> kDefaultCorpus = {
+    "logo.png",
+    "lenna_grayscale.png",
+    "lenna_index.png",
+    "logo_alpha.png",
+    "1.png",
+    "inter.png",
+    "alpha_grayscale.png",
+};
+
+std::string ReadFile(const std::string& filename) {
+    std::ifstream input(filename, std::ios_base::binary | std::ios_base::in);
+    if (!input) {
+        throw error::unable_to_open_file(filename);
+    }
+    return std::string(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+}
+
+double BenchBackend(const std::vector<std::string>& corpus, int iterations, const png_decoder::DecoderOptions& options) {
+    size_t total_bytes = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < iterations; ++i) {
+        for (const auto& file : corpus) {
+            std::span<const uint8_t> bytes(reinterpret_cast<const uint8_t*>(file.data()), file.size());
+            Image image = DecodePng(bytes, options);
+            static_cast<void>(image);
+            total_bytes += file.size();
+        }
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return static_cast<double>(total_bytes) / (1024.0 * 1024.0) / elapsed.count();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? std::stoi(argv[1]) : 10;
+
+    std::vector<std::string> filenames;
+    for (int i = 2; i < argc; ++i) {
+        filenames.emplace_back(argv[i]);
+    }
+    if (filenames.empty()) {
+        for (const auto& name : kDefaultCorpus) {
+            filenames.push_back(std::string(TASK_DIR) + "tests/" + name);
+        }
+    }
+
+    std::vector<std::string> corpus;
+    for (const auto& filename : filenames) {
+        corpus.push_back(ReadFile(filename));
+    }
+
+    for (auto backend : png_decoder::inflater::available_backends()) {
+        png_decoder::DecoderOptions options;
+        options.inflate_backend = backend;
+
+        double throughput = BenchBackend(corpus, iterations, options);
+        std::cout << std::left << std::setw(12) << png_decoder::inflater::to_string(backend)
+                  << std::fixed << std::setprecision(2) << throughput << " MB/s" << std::endl;
+    }
+
+    png_decoder::DecoderOptions fused_options;
+    fused_options.fused_rows = true;
+    double fused_throughput = BenchBackend(corpus, iterations, fused_options);
+    std::cout << std::left << std::setw(12) << "fused rows"
+              << std::fixed << std::setprecision(2) << fused_throughput << " MB/s" << std::endl;
+
+    png_decoder::DecoderOptions pipelined_options;
+    pipelined_options.pipelined_rows = true;
+    double pipelined_throughput = BenchBackend(corpus, iterations, pipelined_options);
+    std::cout << std::left << std::setw(12) << "pipelined"
+              << std::fixed << std::setprecision(2) << pipelined_throughput << " MB/s" << std::endl;
+
+    return 0;
+}
@@ -2,38 +2,191 @@
 
 #include <iostream>
 #include <vector>
+#include <cstdint>
+#include <cstddef>
 
-struct RGB {
-    int r = 0, g = 0, b = 0, a = 0;
-    bool operator==(const RGB& rhs) const {
-        return r == rhs.r && g == rhs.g && b == rhs.b && a == rhs.a;
+// packed pixel formats, channels are stored in the order they are listed
+enum class PixelFormat : uint8_t {
+    GRAY8 = 0,
+    GRAY_ALPHA8 = 1,
+    RGB8 = 2,
+    RGBA8 = 3,
+    RGBA16 = 4
+};
+
+// memory layout of one pixel of a format
+struct PixelLayout {
+    PixelFormat format;
+    uint8_t channels;
+    uint8_t bytes_per_channel;
+    bool has_alpha;
+
+    constexpr size_t bytes_per_pixel() const {
+        return static_cast<size_t>(channels) * bytes_per_channel;
     }
 };
 
-inline std::ostream& operator<<(std::ostream& out, const RGB& x) {
+struct Gray8 {
+    constexpr static PixelLayout LAYOUT = { PixelFormat::GRAY8, 1, 1, false };
+    uint8_t v = 0;
+    bool operator==(const Gray8& rhs) const = default;
+};
+
+struct GrayA8 {
+    constexpr static PixelLayout LAYOUT = { PixelFormat::GRAY_ALPHA8, 2, 1, true };
+    uint8_t v = 0, a = 0;
+    bool operator==(const GrayA8& rhs) const = default;
+};
+
+struct RGB8 {
+    constexpr static PixelLayout LAYOUT = { PixelFormat::RGB8, 3, 1, false };
+    uint8_t r = 0, g = 0, b = 0;
+    bool operator==(const RGB8& rhs) const = default;
+};
+
+struct RGBA8 {
+    constexpr static PixelLayout LAYOUT = { PixelFormat::RGBA8, 4, 1, true };
+    uint8_t r = 0, g = 0, b = 0, a = 0;
+    bool operator==(const RGBA8& rhs) const = default;
+};
+
+struct RGBA16 {
+    constexpr static PixelLayout LAYOUT = { PixelFormat::RGBA16, 4, 2, true };
+    uint16_t r = 0, g = 0, b = 0, a = 0;
+    bool operator==(const RGBA16& rhs) const = default;
+};
+
+static_assert(sizeof(Gray8) == Gray8::LAYOUT.bytes_per_pixel());
+static_assert(sizeof(GrayA8) == GrayA8::LAYOUT.bytes_per_pixel());
+static_assert(sizeof(RGB8) == RGB8::LAYOUT.bytes_per_pixel());
+static_assert(sizeof(RGBA8) == RGBA8::LAYOUT.bytes_per_pixel());
+static_assert(sizeof(RGBA16) == RGBA16::LAYOUT.bytes_per_pixel());
+
+inline std::ostream& operator<<(std::ostream& out, const Gray8& x) {
+    out << +x.v;
+    return out;
+}
+
+inline std::ostream& operator<<(std::ostream& out, const GrayA8& x) {
+    out << +x.v << " " << +x.a;
+    return out;
+}
+
+inline std::ostream& operator<<(std::ostream& out, const RGB8& x) {
+    out << +x.r << " " << +x.g << " " << +x.b;
+    return out;
+}
+
+inline std::ostream& operator<<(std::ostream& out, const RGBA8& x) {
+    out << +x.r << " " << +x.g << " " << +x.b << " " << +x.a;
+    return out;
+}
+
+inline std::ostream& operator<<(std::ostream& out, const RGBA16& x) {
     out << x.r << " " << x.g << " " << x.b << " " << x.a;
     return out;
 }
 
-class Image {
+// any format widened to RGBA16 (8-bit channels are replicated, 0xab -> 0xabab) and narrowed back from it
+// (the high byte is kept); formats without alpha are fully opaque
+inline RGBA16 ToRGBA16(const Gray8& x) {
+    uint16_t v = x.v * 0x101;
+    return RGBA16{ v, v, v, 0xffff };
+}
+
+inline RGBA16 ToRGBA16(const GrayA8& x) {
+    uint16_t v = x.v * 0x101;
+    return RGBA16{ v, v, v, static_cast<uint16_t>(x.a * 0x101) };
+}
+
+inline RGBA16 ToRGBA16(const RGB8& x) {
+    return RGBA16{ static_cast<uint16_t>(x.r * 0x101), static_cast<uint16_t>(x.g * 0x101), static_cast<uint16_t>(x.b * 0x101), 0xffff };
+}
+
+inline RGBA16 ToRGBA16(const RGBA8& x) {
+    return RGBA16{ static_cast<uint16_t>(x.r * 0x101), static_cast<uint16_t>(x.g * 0x101), static_cast<uint16_t>(x.b * 0x101), static_cast<uint16_t>(x.a * 0x101) };
+}
+
+inline RGBA16 ToRGBA16(const RGBA16& x) {
+    return x;
+}
+
+template <class Pixel>
+Pixel FromRGBA16(const RGBA16& x);
+
+template <>
+inline Gray8 FromRGBA16<Gray8>(const RGBA16& x) {
+    // luma of Rec. 601, the gray formats hold it for color pixels
+    return Gray8{ static_cast<uint8_t>((299u * x.r + 587u * x.g + 114u * x.b) / 1000 >> 8) };
+}
+
+template <>
+inline GrayA8 FromRGBA16<GrayA8>(const RGBA16& x) {
+    return GrayA8{ FromRGBA16<Gray8>(x).v, static_cast<uint8_t>(x.a >> 8) };
+}
+
+template <>
+inline RGB8 FromRGBA16<RGB8>(const RGBA16& x) {
+    return RGB8{ static_cast<uint8_t>(x.r >> 8), static_cast<uint8_t>(x.g >> 8), static_cast<uint8_t>(x.b >> 8) };
+}
+
+template <>
+inline RGBA8 FromRGBA16<RGBA8>(const RGBA16& x) {
+    return RGBA8{ static_cast<uint8_t>(x.r >> 8), static_cast<uint8_t>(x.g >> 8), static_cast<uint8_t>(x.b >> 8), static_cast<uint8_t>(x.a >> 8) };
+}
+
+template <>
+inline RGBA16 FromRGBA16<RGBA16>(const RGBA16& x) {
+    return x;
+}
+
+// pixels of one of the formats above, packed row after row without padding
+template <class Pixel = RGBA8>
+class BasicImage {
 public:
-    Image() {}
-    Image(int height, int width) {
+    using PixelType = Pixel;
+    constexpr static PixelLayout LAYOUT = Pixel::LAYOUT;
+
+    BasicImage() {}
+    BasicImage(int height, int width) {
         SetSize(height, width);
     }
 
     void SetSize(int height, int width) {
         height_ = height;
         width_ = width;
-        data_.resize(height_ * width_);
+        // the pixel count does not fit into `int` for large images
+        data_.resize(static_cast<size_t>(height_) * static_cast<size_t>(width_));
+    }
+
+    const Pixel& operator()(int row, int col) const {
+        return data_[static_cast<size_t>(width_) * row + col];
+    }
+
+    Pixel& operator()(int row, int col) {
+        return data_[static_cast<size_t>(width_) * row + col];
+    }
+
+    // first pixel of row `row`, the row holds `Width()` pixels
+    const Pixel* Row(int row) const {
+        return data_.data() + static_cast<size_t>(width_) * row;
     }
 
-    const RGB& operator()(int row, int col) const {
-        return data_[width_ * row + col];
+    Pixel* Row(int row) {
+        return data_.data() + static_cast<size_t>(width_) * row;
     }
 
-    RGB& operator()(int row, int col) {
-        return data_[width_ * row + col];
+    // bytes between the starts of two rows
+    size_t Stride() const {
+        return static_cast<size_t>(width_) * sizeof(Pixel);
+    }
+
+    const Pixel* Data() const {
+        return data_.data();
+    }
+
+    Pixel* Data() {
+        return data_.data();
     }
 
     int Height() const {
@@ -44,7 +197,27 @@ public:
         return width_;
     }
 private:
-    std::vector<RGB> data_;
+    std::vector<Pixel> data_;
     int height_ = 0;
     int width_ = 0;
 };
+
+using Image = BasicImage<RGBA8>;
+using Gray8Image = BasicImage<Gray8>;
+using GrayA8Image = BasicImage<GrayA8>;
+using RGB8Image = BasicImage<RGB8>;
+using RGBA16Image = BasicImage<RGBA16>;
+
+// converts every pixel through RGBA16, see `ToRGBA16` and `FromRGBA16`
+template <class To, class From>
+BasicImage<To> ConvertImage(const BasicImage<From>& image) {
+    BasicImage<To> result(image.Height(), image.Width());
+    for (int y = 0; y < image.Height(); ++y) {
+        const From* source = image.Row(y);
+        To* dest = result.Row(y);
+        for (int x = 0; x < image.Width(); ++x) {
+            dest[x] = FromRGBA16<To>(ToRGBA16(source[x]));
+        }
+    }
+    return result;
+}
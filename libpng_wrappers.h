@@ -100,7 +100,7 @@ inline Image ReadImage(std::string_view filename) {
     for (int i = 0; i < height; ++i) {
         for (int j = 0; j < width; ++j) {
             auto data = storage.GetPixel(i, j);
-            result(i, j) = RGB{data[0], data[1], data[2], data[3]};
+            result(i, j) = RGBA8{data[0], data[1], data[2], data[3]};
         }
     }
     return result;
@@ -1,16 +1,263 @@
 #include "crc_calculator.h"
 
 // stl includes
-#include <iostream>
+#include <array>
+#include <bit>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PNG_DECODER_CRC_X86
+#endif
 
 namespace png_decoder::crc_calculator {
 
-    
+    namespace {
+        using Tables = std::array<std::array<uint32_t, 256>, 16>;
+
+        // tables[0] is the classic byte-wise table, tables[k][b] is the crc of byte `b` followed by `k` zero bytes
+        constexpr Tables make_tables() {
+            Tables tables{};
+            for (uint32_t byte = 0; byte < 256; ++byte) {
+                uint32_t crc = byte;
+                for (int bit = 0; bit < 8; ++bit) {
+                    crc = (crc >> 1) ^ ((crc & 1) ? POLYNOMIAL : 0);
+                }
+                tables[0][byte] = crc;
+            }
+            for (size_t k = 1; k < tables.size(); ++k) {
+                for (uint32_t byte = 0; byte < 256; ++byte) {
+                    uint32_t previous = tables[k - 1][byte];
+                    tables[k][byte] = (previous >> 8) ^ tables[0][previous & 0xff];
+                }
+            }
+            return tables;
+        }
+
+        constexpr Tables TABLES = make_tables();
+
+        // product of two polynomials modulo the crc polynomial, bit-reflected (x^0 is the top bit)
+        constexpr uint32_t multiply_modulo(uint32_t a, uint32_t b) noexcept {
+            uint32_t product = 0;
+            for (uint32_t mask = uint32_t(1) << 31; mask != 0; mask >>= 1) {
+                if (a & mask) {
+                    product ^= b;
+                }
+                b = (b & 1) ? (b >> 1) ^ POLYNOMIAL : b >> 1;
+            }
+            return product;
+        }
+
+        // powers[k] = x^(2^k) modulo the crc polynomial, enough for shifts by any 64-bit byte count
+        constexpr std::array<uint32_t, 67> make_powers() {
+            std::array<uint32_t, 67> powers{};
+            uint32_t power = uint32_t(1) << 30; // x^1
+            for (auto& entry : powers) {
+                entry = power;
+                power = multiply_modulo(power, power);
+            }
+            return powers;
+        }
+
+        constexpr std::array<uint32_t, 67> POWERS = make_powers();
+
+        inline uint32_t load_le32(const uint8_t* bytes) noexcept {
+            uint32_t value;
+            std::memcpy(&value, bytes, sizeof(value));
+            if constexpr (std::endian::native == std::endian::big) {
+                value = __builtin_bswap32(value);
+            }
+            return value;
+        }
+
+        // works on the inverted crc register
+        uint32_t update_slice_by_16(uint32_t crc, const uint8_t* bytes, size_t length) noexcept {
+            while (length >= 16) {
+                uint32_t a = load_le32(bytes) ^ crc;
+                uint32_t b = load_le32(bytes + 4);
+                uint32_t c = load_le32(bytes + 8);
+                uint32_t d = load_le32(bytes + 12);
+
+                crc = TABLES[15][a & 0xff] ^ TABLES[14][(a >> 8) & 0xff] ^ TABLES[13][(a >> 16) & 0xff] ^ TABLES[12][a >> 24]
+                    ^ TABLES[11][b & 0xff] ^ TABLES[10][(b >> 8) & 0xff] ^ TABLES[9][(b >> 16) & 0xff] ^ TABLES[8][b >> 24]
+                    ^ TABLES[7][c & 0xff] ^ TABLES[6][(c >> 8) & 0xff] ^ TABLES[5][(c >> 16) & 0xff] ^ TABLES[4][c >> 24]
+                    ^ TABLES[3][d & 0xff] ^ TABLES[2][(d >> 8) & 0xff] ^ TABLES[1][(d >> 16) & 0xff] ^ TABLES[0][d >> 24];
+
+                bytes += 16;
+                length -= 16;
+            }
+
+            while (length--) {
+                crc = (crc >> 8) ^ TABLES[0][(crc ^ *bytes++) & 0xff];
+            }
+
+            return crc;
+        }
+
+#ifdef PNG_DECODER_CRC_X86
+        inline __m128i load(const uint8_t* bytes) noexcept {
+            return _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes));
+        }
+
+        // multiplies both halves of `lane` by the matching fold constants and adds the next 128 bits
+        __attribute__((target("pclmul,sse4.1")))
+        inline __m128i fold(__m128i lane, __m128i next, __m128i constants) noexcept {
+            __m128i low = _mm_clmulepi64_si128(lane, constants, 0x00);
+            __m128i high = _mm_clmulepi64_si128(lane, constants, 0x11);
+            return _mm_xor_si128(_mm_xor_si128(high, low), next);
+        }
+
+        // Folding with carry-less multiplication ("Fast CRC Computation for Generic Polynomials Using PCLMULQDQ",
+        // Intel 2009): four 128-bit lanes are folded 64 bytes ahead, then into one lane, which is reduced to 32 bits
+        // with Barrett reduction. Works on the inverted crc register, `length` must be at least 64.
+        __attribute__((target("pclmul,sse4.1")))
+        uint32_t update_pclmul_blocks(uint32_t crc, const uint8_t* bytes, size_t length) noexcept {
+            // x^(4*128+32) mod P, x^(4*128-32) mod P (bit-reflected)
+            const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+            // x^(128+32) mod P, x^(128-32) mod P
+            const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+            // x^64 mod P
+            const __m128i k5k0 = _mm_set_epi64x(0, 0x0163cd6124);
+            // P and floor(x^64 / P)
+            const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+            const __m128i low32_mask = _mm_setr_epi32(~0, 0, ~0, 0);
+
+            __m128i x1 = _mm_xor_si128(load(bytes), _mm_cvtsi32_si128(static_cast<int>(crc)));
+            __m128i x2 = load(bytes + 16);
+            __m128i x3 = load(bytes + 32);
+            __m128i x4 = load(bytes + 48);
+            bytes += 64;
+            length -= 64;
+
+            while (length >= 64) {
+                x1 = fold(x1, load(bytes), k1k2);
+                x2 = fold(x2, load(bytes + 16), k1k2);
+                x3 = fold(x3, load(bytes + 32), k1k2);
+                x4 = fold(x4, load(bytes + 48), k1k2);
+                bytes += 64;
+                length -= 64;
+            }
+
+            x1 = fold(x1, x2, k3k4);
+            x1 = fold(x1, x3, k3k4);
+            x1 = fold(x1, x4, k3k4);
+
+            while (length >= 16) {
+                x1 = fold(x1, load(bytes), k3k4);
+                bytes += 16;
+                length -= 16;
+            }
+
+            // 128 -> 64 bits
+            __m128i x = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+            x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x);
+            x = _mm_srli_si128(x1, 4);
+            x1 = _mm_and_si128(x1, low32_mask);
+            x1 = _mm_xor_si128(_mm_clmulepi64_si128(x1, k5k0, 0x00), x);
+
+            // Barrett reduction 64 -> 32 bits
+            x = _mm_and_si128(x1, low32_mask);
+            x = _mm_clmulepi64_si128(x, poly, 0x10);
+            x = _mm_and_si128(x, low32_mask);
+            x = _mm_clmulepi64_si128(x, poly, 0x00);
+            x1 = _mm_xor_si128(x1, x);
+
+            crc = static_cast<uint32_t>(_mm_extract_epi32(x1, 1));
+            return update_slice_by_16(crc, bytes, length);
+        }
+
+        uint32_t update_pclmul(uint32_t crc, const uint8_t* bytes, size_t length) noexcept {
+            // short inputs (most ancillary chunks) do not pay for the setup
+            if (length < 64) {
+                return update_slice_by_16(crc, bytes, length);
+            }
+            return update_pclmul_blocks(crc, bytes, length);
+        }
+
+        bool has_pclmul() noexcept {
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+        }
+#endif
+
+        using UpdateFunction = uint32_t (*)(uint32_t, const uint8_t*, size_t) noexcept;
+
+        UpdateFunction get_update_function(Implementation implementation) noexcept {
+            switch (implementation) {
+#ifdef PNG_DECODER_CRC_X86
+                case Implementation::PCLMUL:
+                    return update_pclmul;
+#endif
+                default:
+                    return update_slice_by_16;
+            }
+        }
+    }
+
+    Implementation default_implementation() noexcept {
+        static const Implementation implementation = is_implementation_available(Implementation::PCLMUL)
+            ? Implementation::PCLMUL
+            : Implementation::SLICE_BY_16;
+        return implementation;
+    }
+
+    bool is_implementation_available(Implementation implementation) noexcept {
+        switch (implementation) {
+            case Implementation::SLICE_BY_16:
+                return true;
+            case Implementation::PCLMUL:
+#ifdef PNG_DECODER_CRC_X86
+                return has_pclmul();
+#else
+                return false;
+#endif
+        }
+        return false;
+    }
+
+    std::vector<Implementation> available_implementations() {
+        std::vector<Implementation> implementations;
+        for (auto implementation : { Implementation::SLICE_BY_16, Implementation::PCLMUL }) {
+            if (is_implementation_available(implementation)) {
+                implementations.push_back(implementation);
+            }
+        }
+        return implementations;
+    }
+
+    std::string to_string(Implementation implementation) {
+        switch (implementation) {
+            case Implementation::SLICE_BY_16:
+                return "slice-by-16";
+            case Implementation::PCLMUL:
+                return "pclmul";
+        }
+        return "unknown";
+    }
+
+    uint32_t update_crc32_checksum(uint32_t crc, const void* bytes, size_t length) noexcept {
+        static const UpdateFunction update = get_update_function(default_implementation());
+        return ~update(~crc, static_cast<const uint8_t*>(bytes), length);
+    }
+
+    uint32_t update_crc32_checksum(Implementation implementation, uint32_t crc, const void* bytes, size_t length) noexcept {
+        return ~get_update_function(implementation)(~crc, static_cast<const uint8_t*>(bytes), length);
+    }
+
+    uint32_t combine_crc32_checksums(uint32_t first, uint32_t second, uint64_t second_length) noexcept {
+        // appending n zero bytes multiplies the crc register by x^(8n), the pre- and post-inversions of the second
+        // sequence cancel out with the ones of the concatenation
+        uint32_t shift = uint32_t(1) << 31; // x^0
+        for (size_t k = 3; second_length != 0; second_length >>= 1, ++k) {
+            if (second_length & 1) {
+                shift = multiply_modulo(POWERS[k], shift);
+            }
+        }
+        return multiply_modulo(shift, first) ^ second;
+    }
+
     uint32_t get_crc32_checksum(const char* bytes, uint32_t length) {
-        // Compute the CRC of the chunk data and validate it
-        boost::crc_optimal<BITS_COUNT, TRUNC_POLICY, INITIAL_REMAINDER, FINAL_XOR, LOWEST_TO_HIGHEST, REMAINDER_BEFORE_XOR> crc;
-        crc.process_bytes(bytes, length);
-        return crc.checksum();
+        return update_crc32_checksum(0, bytes, length);
     }
 
-}
\ No newline at end of file
+}
@@ -1,20 +1,38 @@
 #pragma once
 
 // stl includes
-#include <boost/crc.hpp>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
 
 // custom includes
 
 
 
 namespace png_decoder::crc_calculator {
-    static inline const auto BITS_COUNT = 32;
-    static inline const auto TRUNC_POLICY = 0x4C11DB7;
-    static inline const auto INITIAL_REMAINDER = 0xFFFFFFFF;
-    static inline const auto FINAL_XOR = 0xFFFFFFFF;
-    static inline const auto LOWEST_TO_HIGHEST = true;
-    static inline const auto REMAINDER_BEFORE_XOR = true;
+    // CRC-32 of ISO 3309 / ITU-T V.42 as used by PNG and zlib (reflected polynomial 0xEDB88320)
+    static inline const uint32_t POLYNOMIAL = 0xEDB88320;
+
+    enum class Implementation : uint8_t {
+        SLICE_BY_16 = 0, // portable, 16 table lookups per 16 bytes
+        PCLMUL = 1       // x86 carry-less multiplication folding
+    };
+
+    // fastest implementation supported by the running CPU, picked once on first use
+    Implementation default_implementation() noexcept;
+    bool is_implementation_available(Implementation implementation) noexcept;
+    std::vector<Implementation> available_implementations();
+    std::string to_string(Implementation implementation);
+
+    // continues `crc` of the preceding bytes over `length` more bytes, start with 0;
+    // feeding a sequence piece by piece gives the same result as feeding it at once
+    uint32_t update_crc32_checksum(uint32_t crc, const void* bytes, size_t length) noexcept;
+    uint32_t update_crc32_checksum(Implementation implementation, uint32_t crc, const void* bytes, size_t length) noexcept;
+
+    // crc of the concatenation of two sequences from their crcs, `second_length` is the length of the second one
+    uint32_t combine_crc32_checksums(uint32_t first, uint32_t second, uint64_t second_length) noexcept;
 
     uint32_t get_crc32_checksum(const char* bytes, uint32_t length);
 
-}
\ No newline at end of file
+}
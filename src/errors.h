@@ -59,6 +59,10 @@ namespace png_decoder::error {
         explicit unsupported_interlace_method(std::string msg) : std::runtime_error("Unsupported interlace method provided: '" + msg + "'") {}
     };
 
+    struct limit_exceeded : std::runtime_error {
+        explicit limit_exceeded(std::string msg) : std::runtime_error("Decode limit exceeded: '" + msg + "'") {}
+    };
+
 } // namespace png_decoder::error
 
 namespace png_decoder::inflater::error {
@@ -79,6 +83,14 @@ namespace png_decoder::inflater::error {
         explicit version_lib_mismatch() : std::runtime_error("Zlib library version mismatch") {}
     };
 
+    struct unavailable_backend : std::runtime_error {
+        explicit unavailable_backend(std::string name) : std::runtime_error("Inflate backend is not available in this build: '" + name + "'") {}
+    };
+
+    struct unexpected_inflated_size : std::runtime_error {
+        explicit unexpected_inflated_size(std::string msg) : std::runtime_error("Unexpected inflated data size: '" + msg + "'") {}
+    };
+
 } // namespace png_decoder::inflater::error
 
 
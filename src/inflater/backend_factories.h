@@ -0,0 +1,25 @@
+#pragma once
+
+// stl includes
+#include <memory>
+#include <memory_resource>
+
+// custom includes
+#include "inflate_backend.h"
+
+
+
+namespace png_decoder::inflater {
+
+// each backend is created in its own translation unit, so the headers of the libraries never meet:
+// zlib.h and zlib-ng.h define the same macros (`Z_OK`, `Z_NULL`, ...)
+std::unique_ptr<InflateBackend> create_zlib_backend(std::pmr::memory_resource* resource);
+std::unique_ptr<InflateBackend> create_native_backend();
+#ifdef PNG_DECODER_WITH_ZLIB_NG
+std::unique_ptr<InflateBackend> create_zlib_ng_backend(std::pmr::memory_resource* resource);
+#endif
+#ifdef PNG_DECODER_WITH_LIBDEFLATE
+std::unique_ptr<InflateBackend> create_libdeflate_backend();
+#endif
+
+}
@@ -0,0 +1,851 @@
+#include "deflate_decoder.h"
+
+// stl includes
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <algorithm>
+
+// custom includes
+#include "../errors.h"
+
+
+namespace png_decoder::inflater::deflate {
+
+    namespace {
+        using Kind = HuffmanTable::Kind;
+
+        constexpr std::array<uint16_t, 29> LENGTH_BASE = {
+            3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+            35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+        };
+        constexpr std::array<uint8_t, 29> LENGTH_EXTRA_BITS = {
+            0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+            3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+        };
+        constexpr std::array<uint16_t, 30> DISTANCE_BASE = {
+            1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+            257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+        };
+        constexpr std::array<uint8_t, 30> DISTANCE_EXTRA_BITS = {
+            0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+            7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+        };
+        // order in which code lengths of the precode are stored
+        constexpr std::array<uint8_t, 19> PRECODE_ORDER = {
+            16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+        };
+
+        constexpr uint32_t END_OF_BLOCK_SYMBOL = 256;
+        constexpr uint32_t FIRST_LENGTH_SYMBOL = 257;
+
+        inline uint32_t reverse_bits(uint32_t code, uint32_t length) {
+            uint32_t result = 0;
+            for (uint32_t i = 0; i < length; ++i) {
+                result = (result << 1) | (code & 1);
+                code >>= 1;
+            }
+            return result;
+        }
+
+        inline uint64_t load_u64(const uint8_t* source) {
+            uint64_t value;
+            std::memcpy(&value, source, sizeof(value));
+            return value;
+        }
+
+        inline void store_u64(uint8_t* dest, uint64_t value) {
+            std::memcpy(dest, &value, sizeof(value));
+        }
+
+        // copies a match of `length` bytes from `distance` bytes back,
+        // may write up to `WIDE_COPY_SLACK` - 1 bytes past the end of the match
+        template <size_t WIDTH>
+        inline void copy_wide(uint8_t* out, const uint8_t* source, size_t length) {
+            uint8_t* out_end = out + length;
+            do {
+                std::memcpy(out, source, WIDTH);
+                out += WIDTH;
+                source += WIDTH;
+            } while (out < out_end);
+        }
+
+        inline void copy_match_wide(uint8_t* out, size_t distance, size_t length) {
+            const uint8_t* source = out - distance;
+
+            if (distance >= 32) {
+                copy_wide<32>(out, source, length);
+            }
+            else if (distance >= 16) {
+                copy_wide<16>(out, source, length);
+            }
+            else if (distance >= 8) {
+                copy_wide<8>(out, source, length);
+            }
+            else if (distance == 1) {
+                // run of a single byte
+                uint64_t pattern = source[0] * uint64_t(0x0101010101010101);
+                uint8_t* out_end = out + length;
+                do {
+                    store_u64(out, pattern);
+                    out += 8;
+                } while (out < out_end);
+            }
+            else {
+                // the pattern repeats every `distance` bytes: copy bytes one by one until it spans
+                // at least 8 bytes, after that 8-byte copies from a multiple of `distance` back are safe
+                size_t widened_distance = distance * ((8 + distance - 1) / distance);
+                size_t head = std::min(length, widened_distance);
+                for (size_t i = 0; i < head; ++i) {
+                    out[i] = source[i];
+                }
+                if (length > head) {
+                    uint8_t* tail = out + head;
+                    const uint8_t* tail_source = tail - widened_distance;
+                    uint8_t* out_end = out + length;
+                    do {
+                        store_u64(tail, load_u64(tail_source));
+                        tail += 8;
+                        tail_source += 8;
+                    } while (tail < out_end);
+                }
+            }
+        }
+
+        inline void copy_match_exact(uint8_t* out, size_t distance, size_t length) {
+            const uint8_t* source = out - distance;
+            for (size_t i = 0; i < length; ++i) {
+                out[i] = source[i];
+            }
+        }
+
+        // writes the one or two literals of a literal entry
+        inline void write_literals(uint8_t*& out, uint32_t entry) {
+            uint32_t literals = HuffmanTable::entry_payload(entry);
+            out[0] = static_cast<uint8_t>(literals);
+            if (HuffmanTable::entry_kind(entry) == Kind::LITERAL_PAIR) {
+                out[1] = static_cast<uint8_t>(literals >> 8);
+                out += 2;
+            }
+            else {
+                out += 1;
+            }
+        }
+
+        // fast loop variant: both bytes are stored unconditionally, the kind value is the number of literals
+        inline void write_literals_unchecked(uint8_t*& out, uint32_t entry) {
+            uint32_t literals = HuffmanTable::entry_payload(entry);
+            out[0] = static_cast<uint8_t>(literals);
+            out[1] = static_cast<uint8_t>(literals >> 8);
+            out += static_cast<uint32_t>(HuffmanTable::entry_kind(entry));
+        }
+
+        inline bool is_literal(Kind kind) {
+            static_assert(static_cast<uint32_t>(Kind::LITERAL) == 1 && static_cast<uint32_t>(Kind::LITERAL_PAIR) == 2);
+            return static_cast<uint32_t>(kind) - 1 < 2;
+        }
+
+        inline size_t decode_distance(InputBitStream& in, const HuffmanTable& distance) {
+            uint32_t entry = distance.decode(in);
+            if (HuffmanTable::entry_kind(entry) != Kind::DISTANCE) {
+                throw error::invalid_inflate_data();
+            }
+            in.consume(HuffmanTable::entry_bits(entry));
+            return HuffmanTable::entry_payload(entry) + in.pop(HuffmanTable::entry_extra_bits(entry));
+        }
+
+        [[noreturn]] void throw_overrun(const InputBitStream& in, size_t capacity) {
+            if (in.is_overread()) {
+                // zeros read past the end of a truncated stream decoded into output
+                throw error::invalid_inflate_data();
+            }
+            throw error::unexpected_inflated_size("inflated data exceeds expected " + std::to_string(capacity) + " bytes");
+        }
+    }
+
+
+    // InputBitStream
+
+    InputBitStream::InputBitStream(const std::vector<std::span<const uint8_t>>& sources) :
+        m_sources(sources),
+        m_source_index(0),
+        m_source_offset(0),
+        m_source_begin(nullptr),
+        m_in_next(nullptr),
+        m_in_end(nullptr),
+        m_bitbuf(0),
+        m_bitsleft(0),
+        m_overread_bytes(0)
+    {
+        if (!m_sources.empty()) {
+            m_source_begin = m_sources[0].data();
+            m_in_next = m_source_begin;
+            m_in_end = m_in_next + m_sources[0].size();
+        }
+    }
+
+    bool InputBitStream::next_source() {
+        for (size_t index = m_source_index + 1; index < m_sources.size(); ++index) {
+            if (!m_sources[index].empty()) {
+                m_source_offset += m_in_end - m_source_begin;
+                m_source_index = index;
+                m_source_begin = m_sources[index].data();
+                m_in_next = m_source_begin;
+                m_in_end = m_in_next + m_sources[index].size();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    uint64_t InputBitStream::position() const noexcept {
+        uint64_t bytes_read = m_source_offset + (m_in_next - m_source_begin) + m_overread_bytes;
+        return bytes_read * 8 - m_bitsleft;
+    }
+
+    void InputBitStream::seek(uint64_t bit_position) {
+        uint64_t byte_position = bit_position / 8;
+
+        m_bitbuf = 0;
+        m_bitsleft = 0;
+        m_overread_bytes = 0;
+
+        if (m_source_begin != nullptr && byte_position >= m_source_offset && byte_position < m_source_offset + (m_in_end - m_source_begin)) {
+            // within the current source, the common case of scanning forward
+            m_in_next = m_source_begin + (byte_position - m_source_offset);
+        }
+        else {
+            seek_source(byte_position);
+        }
+
+        if (bit_position % 8 != 0) {
+            refill();
+            consume(bit_position % 8);
+        }
+    }
+
+    void InputBitStream::seek_source(uint64_t byte_position) {
+        uint64_t offset = 0;
+
+        m_source_index = 0;
+        m_source_offset = 0;
+        m_source_begin = m_sources.empty() ? nullptr : m_sources[0].data();
+        m_in_next = m_source_begin;
+        m_in_end = m_sources.empty() ? nullptr : m_in_next + m_sources[0].size();
+
+        for (size_t index = 0; index < m_sources.size(); ++index) {
+            size_t size = m_sources[index].size();
+            if (size == 0) {
+                continue;
+            }
+
+            m_source_index = index;
+            m_source_offset = offset;
+            m_source_begin = m_sources[index].data();
+            m_in_end = m_source_begin + size;
+
+            if (byte_position < offset + size) {
+                m_in_next = m_source_begin + (byte_position - offset);
+                break;
+            }
+
+            // past the end of input the stream stays at the end of the last source
+            m_in_next = m_in_end;
+            offset += size;
+        }
+    }
+
+    void InputBitStream::refill_slow() {
+        // drop the look-ahead bits of the fast path, bytes are appended one by one from here
+        m_bitbuf &= (uint64_t(1) << m_bitsleft) - 1;
+
+        while (m_bitsleft < 56) {
+            uint8_t byte = 0;
+            if (m_in_next == m_in_end && !next_source()) {
+                ++m_overread_bytes;
+            }
+            else {
+                byte = *m_in_next++;
+            }
+
+            m_bitbuf |= uint64_t(byte) << m_bitsleft;
+            m_bitsleft += 8;
+        }
+    }
+
+    bool InputBitStream::copy_bytes(uint8_t* dest, size_t length) {
+        // bytes already in the bit buffer come first
+        while (length > 0 && m_bitsleft >= 8) {
+            *dest++ = static_cast<uint8_t>(pop(8));
+            --length;
+        }
+        if (length == 0) {
+            return true;
+        }
+
+        // the bit buffer is empty now, the rest is copied straight from the sources
+        m_bitbuf = 0;
+        m_bitsleft = 0;
+        if (m_overread_bytes > 0) {
+            return false;
+        }
+
+        while (length > 0) {
+            if (m_in_next == m_in_end && !next_source()) {
+                return false;
+            }
+
+            size_t count = std::min<size_t>(length, m_in_end - m_in_next);
+            std::memcpy(dest, m_in_next, count);
+            dest += count;
+            m_in_next += count;
+            length -= count;
+        }
+
+        return true;
+    }
+
+    bool InputBitStream::is_overread() const noexcept {
+        // zero bytes are appended last, so the unconsumed ones are at the top of the bit buffer
+        return m_overread_bytes * 8 > m_bitsleft;
+    }
+
+
+    // HuffmanTable
+
+    template <class SymbolEntry>
+    bool HuffmanTable::build(const uint8_t* lengths, size_t count, uint32_t table_bits, SymbolEntry symbol_entry) {
+        std::array<uint32_t, MAX_CODEWORD_LENGTH + 1> length_counts = {};
+        for (size_t symbol = 0; symbol < count; ++symbol) {
+            length_counts[lengths[symbol]]++;
+        }
+        length_counts[0] = 0;
+
+        // Kraft inequality: reject over-subscribed codes and incomplete codes except a single 1-bit code
+        int32_t left = 1;
+        uint32_t max_length = 0;
+        for (uint32_t length = 1; length <= MAX_CODEWORD_LENGTH; ++length) {
+            left <<= 1;
+            left -= length_counts[length];
+            if (left < 0) {
+                return false;
+            }
+            if (length_counts[length] > 0) {
+                max_length = length;
+            }
+        }
+        if (left > 0 && max_length > 1) {
+            return false;
+        }
+
+        // first canonical code of each length
+        std::array<uint32_t, MAX_CODEWORD_LENGTH + 2> next_code = {};
+        uint32_t code = 0;
+        for (uint32_t length = 1; length <= MAX_CODEWORD_LENGTH; ++length) {
+            code = (code + length_counts[length - 1]) << 1;
+            next_code[length] = code;
+        }
+
+        m_table_bits = table_bits;
+        m_mask = (uint64_t(1) << table_bits) - 1;
+        m_entries.assign(size_t(1) << table_bits, make_entry(Kind::INVALID, 0));
+
+        // longest code per primary prefix decides the size of its subtable
+        std::vector<uint8_t> subtable_bits;
+        std::vector<uint32_t> reversed_codes(count, 0);
+        std::array<uint32_t, MAX_CODEWORD_LENGTH + 2> codes = next_code;
+        for (size_t symbol = 0; symbol < count; ++symbol) {
+            uint32_t length = lengths[symbol];
+            if (length == 0) {
+                continue;
+            }
+            reversed_codes[symbol] = reverse_bits(codes[length]++, length);
+
+            if (length > table_bits) {
+                if (subtable_bits.empty()) {
+                    subtable_bits.assign(size_t(1) << table_bits, 0);
+                }
+                uint8_t& bits = subtable_bits[reversed_codes[symbol] & m_mask];
+                bits = std::max<uint8_t>(bits, length - table_bits);
+            }
+        }
+
+        // place subtables after the primary table
+        for (size_t prefix = 0; prefix < subtable_bits.size(); ++prefix) {
+            if (subtable_bits[prefix] == 0) {
+                continue;
+            }
+            uint32_t offset = m_entries.size();
+            m_entries[prefix] = make_entry(Kind::SUBTABLE, offset, subtable_bits[prefix], table_bits);
+            m_entries.resize(m_entries.size() + (size_t(1) << subtable_bits[prefix]), make_entry(Kind::INVALID, 0));
+        }
+
+        for (size_t symbol = 0; symbol < count; ++symbol) {
+            uint32_t length = lengths[symbol];
+            if (length == 0) {
+                continue;
+            }
+
+            uint32_t reversed = reversed_codes[symbol];
+            uint32_t entry = symbol_entry(symbol);
+
+            if (length <= table_bits) {
+                for (uint32_t i = reversed; i < (uint32_t(1) << table_bits); i += uint32_t(1) << length) {
+                    m_entries[i] = entry | length;
+                }
+            }
+            else {
+                uint32_t subtable = m_entries[reversed & m_mask];
+                uint32_t offset = entry_payload(subtable);
+                uint32_t bits = entry_extra_bits(subtable);
+                uint32_t sub_length = length - table_bits;
+                for (uint32_t i = reversed >> table_bits; i < (uint32_t(1) << bits); i += uint32_t(1) << sub_length) {
+                    m_entries[offset + i] = entry | sub_length;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    void HuffmanTable::pair_literals() {
+        size_t primary_size = size_t(1) << m_table_bits;
+        std::vector<uint32_t> single(m_entries.begin(), m_entries.begin() + primary_size);
+
+        for (size_t i = 0; i < primary_size; ++i) {
+            uint32_t first = single[i];
+            if (entry_kind(first) != Kind::LITERAL) {
+                continue;
+            }
+
+            // the bits left after the first codeword index the second one, with the unknown high bits as zeros
+            uint32_t first_bits = entry_bits(first);
+            uint32_t second = single[i >> first_bits];
+            if (entry_kind(second) != Kind::LITERAL || entry_bits(second) > m_table_bits - first_bits) {
+                continue;
+            }
+
+            uint32_t payload = entry_payload(first) | (entry_payload(second) << 8);
+            m_entries[i] = make_entry(Kind::LITERAL_PAIR, payload, 0, first_bits + entry_bits(second));
+        }
+    }
+
+
+    // DeflateDecoder
+
+    DeflateDecoder::DeflateDecoder() {
+        build_static_tables();
+    }
+
+    bool DeflateDecoder::build_litlen_table(HuffmanTable& table, const uint8_t* lengths, size_t count) {
+        bool is_built = table.build(lengths, count, LITLEN_TABLE_BITS, [](size_t symbol) {
+            if (symbol < END_OF_BLOCK_SYMBOL) {
+                return HuffmanTable::make_entry(Kind::LITERAL, symbol);
+            }
+            if (symbol == END_OF_BLOCK_SYMBOL) {
+                return HuffmanTable::make_entry(Kind::END_OF_BLOCK, 0);
+            }
+            size_t index = symbol - FIRST_LENGTH_SYMBOL;
+            if (index < LENGTH_BASE.size()) {
+                return HuffmanTable::make_entry(Kind::LENGTH, LENGTH_BASE[index], LENGTH_EXTRA_BITS[index]);
+            }
+            // symbols 286 and 287 take part in the fixed code but never occur in valid data
+            return HuffmanTable::make_entry(Kind::INVALID, 0);
+        });
+
+        if (is_built) {
+            table.pair_literals();
+        }
+        return is_built;
+    }
+
+    bool DeflateDecoder::build_distance_table(HuffmanTable& table, const uint8_t* lengths, size_t count) {
+        return table.build(lengths, count, DISTANCE_TABLE_BITS, [](size_t symbol) {
+            if (symbol < DISTANCE_BASE.size()) {
+                return HuffmanTable::make_entry(Kind::DISTANCE, DISTANCE_BASE[symbol], DISTANCE_EXTRA_BITS[symbol]);
+            }
+            return HuffmanTable::make_entry(Kind::INVALID, 0);
+        });
+    }
+
+    void DeflateDecoder::build_static_tables() {
+        std::array<uint8_t, MAX_LITLEN_SYMBOLS> litlen_lengths;
+        std::fill(litlen_lengths.begin(), litlen_lengths.begin() + 144, 8);
+        std::fill(litlen_lengths.begin() + 144, litlen_lengths.begin() + 256, 9);
+        std::fill(litlen_lengths.begin() + 256, litlen_lengths.begin() + 280, 7);
+        std::fill(litlen_lengths.begin() + 280, litlen_lengths.end(), 8);
+
+        std::array<uint8_t, MAX_DISTANCE_SYMBOLS> distance_lengths;
+        distance_lengths.fill(5);
+
+        build_litlen_table(m_static_litlen, litlen_lengths.data(), litlen_lengths.size());
+        build_distance_table(m_static_distance, distance_lengths.data(), distance_lengths.size());
+    }
+
+    size_t DeflateDecoder::decode(InputBitStream& in, std::span<uint8_t> dest) {
+        uint8_t* out_begin = dest.data();
+        uint8_t* out = out_begin;
+        uint8_t* out_end = out_begin + dest.size();
+        bool is_final_block = false;
+
+        while (!is_final_block) {
+            BlockType type = read_block_header(in, is_final_block);
+            decode_block(in, type, out_begin, out, out_end);
+
+            if (in.is_overread()) {
+                // the stream is truncated
+                throw error::invalid_inflate_data();
+            }
+        }
+
+        return out - out_begin;
+    }
+
+    bool DeflateDecoder::is_block_start_candidate(InputBitStream& in) {
+        in.refill();
+        in.consume(1);
+        uint32_t block_type = in.pop(2);
+
+        if (block_type == 0) {
+            in.align_to_byte();
+            uint32_t length = in.pop(16);
+            uint32_t inverted_length = in.pop(16);
+            return length == (~inverted_length & 0xffff);
+        }
+        if (block_type != 2) {
+            return false;
+        }
+
+        uint32_t litlen_count = in.pop(5) + 257;
+        uint32_t distance_count = in.pop(5) + 1;
+        uint32_t precode_count = in.pop(4) + 4;
+        if (litlen_count > 286 || distance_count > 30) {
+            return false;
+        }
+
+        // the precode must be a complete prefix code
+        std::array<uint32_t, 8> length_counts = {};
+        for (uint32_t i = 0; i < precode_count; ++i) {
+            in.refill();
+            length_counts[in.pop(3)]++;
+        }
+
+        int32_t left = 1;
+        uint32_t used_lengths = 0;
+        for (uint32_t length = 1; length < length_counts.size(); ++length) {
+            left = (left << 1) - static_cast<int32_t>(length_counts[length]);
+            if (left < 0) {
+                return false;
+            }
+            used_lengths += length_counts[length];
+        }
+        return left == 0 || used_lengths == 1;
+    }
+
+    DeflateDecoder::BlockType DeflateDecoder::read_block_header(InputBitStream& in, bool& is_final) {
+        in.refill();
+        is_final = in.pop(1);
+        uint32_t block_type = in.pop(2);
+
+        switch (block_type) {
+            case 0:
+                return BlockType::STORED;
+            case 1:
+                return BlockType::STATIC_HUFFMAN;
+            case 2:
+                read_dynamic_tables(in);
+                return BlockType::DYNAMIC_HUFFMAN;
+            default:
+                throw error::invalid_inflate_data();
+        }
+    }
+
+    void DeflateDecoder::decode_block(InputBitStream& in, BlockType type, uint8_t* out_begin, uint8_t*& out, uint8_t* out_end) {
+        switch (type) {
+            case BlockType::STORED:
+                decode_stored_block(in, out, out_end);
+                break;
+            case BlockType::STATIC_HUFFMAN:
+                decode_huffman_block(in, m_static_litlen, m_static_distance, out_begin, out, out_end);
+                break;
+            case BlockType::DYNAMIC_HUFFMAN:
+                decode_huffman_block(in, m_litlen, m_distance, out_begin, out, out_end);
+                break;
+        }
+    }
+
+    void DeflateDecoder::decode_block_symbols(
+        InputBitStream& in,
+        BlockType type,
+        std::vector<uint16_t>& out,
+        size_t max_size,
+        bool allow_markers
+    ) {
+        if (type == BlockType::STORED) {
+            uint32_t length = read_stored_block_length(in);
+            if (out.size() + length > max_size) {
+                throw_overrun(in, max_size);
+            }
+
+            std::vector<uint8_t> bytes(length);
+            if (!in.copy_bytes(bytes.data(), length)) {
+                throw error::invalid_inflate_data();
+            }
+            out.insert(out.end(), bytes.begin(), bytes.end());
+            return;
+        }
+
+        const HuffmanTable& litlen = (type == BlockType::STATIC_HUFFMAN) ? m_static_litlen : m_litlen;
+        const HuffmanTable& distance = (type == BlockType::STATIC_HUFFMAN) ? m_static_distance : m_distance;
+
+        while (true) {
+            in.refill();
+            uint32_t entry = litlen.decode(in);
+            in.consume(HuffmanTable::entry_bits(entry));
+
+            switch (HuffmanTable::entry_kind(entry)) {
+                case Kind::LITERAL_PAIR: {
+                    uint32_t literals = HuffmanTable::entry_payload(entry);
+                    out.push_back(literals & 0xff);
+                    out.push_back(literals >> 8);
+                    break;
+                }
+                case Kind::LITERAL: {
+                    out.push_back(HuffmanTable::entry_payload(entry));
+                    break;
+                }
+                case Kind::LENGTH: {
+                    size_t length = HuffmanTable::entry_payload(entry) + in.pop(HuffmanTable::entry_extra_bits(entry));
+                    size_t match_distance = decode_distance(in, distance);
+                    size_t position = out.size();
+
+                    if (match_distance > position && (!allow_markers || match_distance - position > WINDOW_SIZE)) {
+                        throw error::invalid_inflate_data();
+                    }
+
+                    out.resize(position + length);
+                    for (size_t i = 0; i < length; ++i) {
+                        // a negative source index falls into the unknown window: byte `WINDOW_SIZE + index` of it
+                        int64_t source = static_cast<int64_t>(position + i) - static_cast<int64_t>(match_distance);
+                        out[position + i] = (source >= 0)
+                            ? out[source]
+                            : static_cast<uint16_t>(MARKER_BASE + WINDOW_SIZE + source);
+                    }
+                    break;
+                }
+                case Kind::END_OF_BLOCK:
+                    return;
+                default:
+                    throw error::invalid_inflate_data();
+            }
+
+            if (out.size() > max_size) {
+                throw_overrun(in, max_size);
+            }
+        }
+    }
+
+    uint32_t DeflateDecoder::read_stored_block_length(InputBitStream& in) {
+        in.align_to_byte();
+        in.refill();
+        uint32_t length = in.pop(16);
+        uint32_t inverted_length = in.pop(16);
+
+        if (length != (~inverted_length & 0xffff)) {
+            throw error::invalid_inflate_data();
+        }
+        return length;
+    }
+
+    void DeflateDecoder::decode_stored_block(InputBitStream& in, uint8_t*& out, uint8_t* out_end) {
+        uint32_t length = read_stored_block_length(in);
+        if (static_cast<size_t>(out_end - out) < length) {
+            throw_overrun(in, out_end - out);
+        }
+        if (!in.copy_bytes(out, length)) {
+            throw error::invalid_inflate_data();
+        }
+
+        out += length;
+    }
+
+    void DeflateDecoder::read_dynamic_tables(InputBitStream& in) {
+        in.refill();
+        uint32_t litlen_count = in.pop(5) + 257;
+        uint32_t distance_count = in.pop(5) + 1;
+        uint32_t precode_count = in.pop(4) + 4;
+
+        if (litlen_count > 286 || distance_count > 30) {
+            throw error::invalid_inflate_data();
+        }
+
+        // up to 19 * 3 bits, more than one refill guarantees
+        std::array<uint8_t, PRECODE_SYMBOLS> precode_lengths = {};
+        for (uint32_t i = 0; i < precode_count; ++i) {
+            in.refill();
+            precode_lengths[PRECODE_ORDER[i]] = in.pop(3);
+        }
+
+        bool is_built = m_precode.build(precode_lengths.data(), precode_lengths.size(), PRECODE_TABLE_BITS, [](size_t symbol) {
+            return HuffmanTable::make_entry(Kind::LITERAL, symbol);
+        });
+        if (!is_built) {
+            throw error::invalid_inflate_data();
+        }
+
+        // literal/length and distance code lengths form one sequence, repeats may cross between them
+        std::array<uint8_t, MAX_LITLEN_SYMBOLS + MAX_DISTANCE_SYMBOLS> lengths = {};
+        uint32_t total_count = litlen_count + distance_count;
+        uint32_t index = 0;
+
+        while (index < total_count) {
+            in.refill();
+            uint32_t entry = m_precode.decode(in);
+            if (HuffmanTable::entry_kind(entry) != Kind::LITERAL) {
+                throw error::invalid_inflate_data();
+            }
+            in.consume(HuffmanTable::entry_bits(entry));
+            uint32_t symbol = HuffmanTable::entry_payload(entry);
+
+            if (symbol < 16) {
+                lengths[index++] = symbol;
+                continue;
+            }
+
+            uint8_t value = 0;
+            uint32_t repeat = 0;
+            if (symbol == 16) {
+                if (index == 0) {
+                    throw error::invalid_inflate_data();
+                }
+                value = lengths[index - 1];
+                repeat = 3 + in.pop(2);
+            }
+            else if (symbol == 17) {
+                repeat = 3 + in.pop(3);
+            }
+            else {
+                repeat = 11 + in.pop(7);
+            }
+
+            if (index + repeat > total_count) {
+                throw error::invalid_inflate_data();
+            }
+            std::fill_n(lengths.begin() + index, repeat, value);
+            index += repeat;
+        }
+
+        if (lengths[END_OF_BLOCK_SYMBOL] == 0) {
+            // a block without the end-of-block code cannot be terminated
+            throw error::invalid_inflate_data();
+        }
+
+        if (!build_litlen_table(m_litlen, lengths.data(), litlen_count) ||
+            !build_distance_table(m_distance, lengths.data() + litlen_count, distance_count)) {
+            throw error::invalid_inflate_data();
+        }
+    }
+
+    void DeflateDecoder::decode_huffman_block(
+        InputBitStream& in,
+        const HuffmanTable& litlen,
+        const HuffmanTable& distance,
+        uint8_t* out_begin,
+        uint8_t*& out,
+        uint8_t* out_end
+    ) {
+        // fast loop: the output has room for two literal pairs and the longest match with the wide copy overshoot,
+        // so no bounds are checked per symbol
+        while (static_cast<size_t>(out_end - out) >= FASTLOOP_MARGIN) {
+            in.refill();
+            uint32_t entry = litlen.decode(in);
+            in.consume(HuffmanTable::entry_bits(entry));
+            Kind kind = HuffmanTable::entry_kind(entry);
+
+            if (is_literal(kind)) {
+                write_literals_unchecked(out, entry);
+
+                // literals take at most 15 bits, so the next codeword is still in the bit buffer
+                entry = litlen.decode(in);
+                in.consume(HuffmanTable::entry_bits(entry));
+                kind = HuffmanTable::entry_kind(entry);
+
+                if (is_literal(kind)) {
+                    write_literals_unchecked(out, entry);
+                    continue;
+                }
+            }
+
+            if (kind == Kind::LENGTH) {
+                in.refill();
+                size_t length = HuffmanTable::entry_payload(entry) + in.pop(HuffmanTable::entry_extra_bits(entry));
+                size_t match_distance = decode_distance(in, distance);
+
+                if (match_distance > static_cast<size_t>(out - out_begin)) {
+                    throw error::invalid_inflate_data();
+                }
+                copy_match_wide(out, match_distance, length);
+                out += length;
+            }
+            else if (kind == Kind::END_OF_BLOCK) {
+                return;
+            }
+            else {
+                throw error::invalid_inflate_data();
+            }
+        }
+
+        // careful loop for the tail of the output
+        while (true) {
+            // 56 bits cover the longest length code, its extra bits, the longest distance code and its extra bits
+            in.refill();
+            uint32_t entry = litlen.decode(in);
+            in.consume(HuffmanTable::entry_bits(entry));
+
+            switch (HuffmanTable::entry_kind(entry)) {
+                case Kind::LITERAL_PAIR: {
+                    if (out_end - out < 2) {
+                        throw_overrun(in, out_end - out_begin);
+                    }
+                    write_literals(out, entry);
+                    break;
+                }
+                case Kind::LITERAL: {
+                    if (out == out_end) {
+                        throw_overrun(in, out_end - out_begin);
+                    }
+                    write_literals(out, entry);
+                    break;
+                }
+                case Kind::LENGTH: {
+                    size_t length = HuffmanTable::entry_payload(entry) + in.pop(HuffmanTable::entry_extra_bits(entry));
+                    size_t match_distance = decode_distance(in, distance);
+
+                    if (match_distance > static_cast<size_t>(out - out_begin)) {
+                        throw error::invalid_inflate_data();
+                    }
+
+                    size_t space = out_end - out;
+                    if (space >= length + WIDE_COPY_SLACK) {
+                        copy_match_wide(out, match_distance, length);
+                    }
+                    else if (space >= length) {
+                        copy_match_exact(out, match_distance, length);
+                    }
+                    else {
+                        throw_overrun(in, out_end - out_begin);
+                    }
+                    out += length;
+                    break;
+                }
+                case Kind::END_OF_BLOCK:
+                    return;
+                default:
+                    throw error::invalid_inflate_data();
+            }
+        }
+    }
+
+}
@@ -0,0 +1,240 @@
+#pragma once
+
+// stl includes
+#include <vector>
+#include <span>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+// custom includes
+
+
+
+namespace png_decoder::inflater::deflate {
+
+// Little-endian bit reader over a list of buffers forming one stream (e.g. IDAT chunks).
+// While the current buffer has at least 8 bytes left the bit buffer is refilled with a single 64-bit load,
+// otherwise it is refilled byte by byte, crossing into the next buffer when needed.
+// Past the end of input zero bytes are supplied and counted, see `is_overread`.
+class InputBitStream {
+public:
+    explicit InputBitStream(const std::vector<std::span<const uint8_t>>& sources);
+
+    // guarantees at least 56 bits in the bit buffer
+    inline void refill() {
+        if (m_in_end - m_in_next >= 8) {
+            uint64_t word;
+            std::memcpy(&word, m_in_next, sizeof(word));
+            if constexpr (std::endian::native == std::endian::big) {
+                word = __builtin_bswap64(word);
+            }
+
+            // bits above `m_bitsleft` are the next input bytes, so or-ing them again is harmless
+            m_bitbuf |= word << m_bitsleft;
+            m_in_next += (63 - m_bitsleft) >> 3;
+            m_bitsleft |= 56;
+        }
+        else {
+            refill_slow();
+        }
+    }
+
+    inline uint64_t bits() const noexcept {
+        return m_bitbuf;
+    }
+
+    inline uint32_t peek(uint32_t count) const noexcept {
+        return static_cast<uint32_t>(m_bitbuf & ((uint64_t(1) << count) - 1));
+    }
+
+    inline void consume(uint32_t count) noexcept {
+        m_bitbuf >>= count;
+        m_bitsleft -= count;
+    }
+
+    inline uint32_t pop(uint32_t count) noexcept {
+        uint32_t value = peek(count);
+        consume(count);
+        return value;
+    }
+
+    inline uint32_t available() const noexcept {
+        return m_bitsleft;
+    }
+
+    inline void align_to_byte() noexcept {
+        consume(m_bitsleft & 7);
+    }
+
+    // copies `length` raw bytes to `dest`, the stream must be byte aligned, returns false if input ends first
+    bool copy_bytes(uint8_t* dest, size_t length);
+
+    // whether zero bytes supplied past the end of input were consumed
+    bool is_overread() const noexcept;
+
+    // number of bits consumed from the start of the stream
+    uint64_t position() const noexcept;
+    // restarts reading at `bit_position` bits from the start of the stream
+    void seek(uint64_t bit_position);
+
+private:
+    std::vector<std::span<const uint8_t>> m_sources;
+    size_t m_source_index;
+    // bytes of the sources before the current one
+    uint64_t m_source_offset;
+    const uint8_t* m_source_begin;
+    const uint8_t* m_in_next;
+    const uint8_t* m_in_end;
+    uint64_t m_bitbuf;
+    uint32_t m_bitsleft;
+    size_t m_overread_bytes;
+
+    void refill_slow();
+    bool next_source();
+    void seek_source(uint64_t byte_position);
+};
+
+
+// Canonical Huffman decoding table.
+// Codes up to `table_bits` long are resolved by a single lookup of the low bits of the bit buffer,
+// longer codes go through a second-level subtable. Each entry is packed into 32 bits:
+//   bits  0..4   codeword bits to consume (both codewords for a literal pair)
+//   bits  5..7   entry kind
+//   bits  8..11  extra bits of a length / distance, or index bits of a subtable
+//   bits 16..31  payload: literal(s), base value or subtable offset
+class HuffmanTable {
+public:
+    enum class Kind : uint8_t {
+        INVALID = 0,
+        LITERAL = 1,
+        LITERAL_PAIR = 2,
+        LENGTH = 3,
+        END_OF_BLOCK = 4,
+        DISTANCE = 5,
+        SUBTABLE = 6
+    };
+
+    static constexpr uint32_t MAX_CODEWORD_LENGTH = 15;
+
+    static inline uint32_t entry_bits(uint32_t entry) noexcept {
+        return entry & 0x1f;
+    }
+
+    static inline Kind entry_kind(uint32_t entry) noexcept {
+        return static_cast<Kind>((entry >> 5) & 0x7);
+    }
+
+    static inline uint32_t entry_extra_bits(uint32_t entry) noexcept {
+        return (entry >> 8) & 0xf;
+    }
+
+    static inline uint32_t entry_payload(uint32_t entry) noexcept {
+        return entry >> 16;
+    }
+
+    static inline uint32_t make_entry(Kind kind, uint32_t payload, uint32_t extra_bits = 0, uint32_t bits = 0) noexcept {
+        return (payload << 16) | (extra_bits << 8) | (static_cast<uint32_t>(kind) << 5) | bits;
+    }
+
+    // builds the table from code lengths, `symbol_entry(symbol)` gives the entry of a symbol without its bits;
+    // returns false for over-subscribed or incomplete codes (a single code of length 1 is allowed)
+    template <class SymbolEntry>
+    bool build(const uint8_t* lengths, size_t count, uint32_t table_bits, SymbolEntry symbol_entry);
+
+    // merges pairs of literals which together fit into the primary table into one entry
+    void pair_literals();
+
+    // entry for the next codeword, descending into a subtable consumes the primary bits from `in`
+    inline uint32_t decode(InputBitStream& in) const noexcept {
+        uint32_t entry = m_entries[in.bits() & m_mask];
+        if (entry_kind(entry) == Kind::SUBTABLE) {
+            in.consume(m_table_bits);
+            entry = m_entries[entry_payload(entry) + in.peek(entry_extra_bits(entry))];
+        }
+        return entry;
+    }
+
+private:
+    std::vector<uint32_t> m_entries;
+    uint32_t m_table_bits = 0;
+    uint64_t m_mask = 0;
+};
+
+
+// Raw DEFLATE (RFC 1951) decoder writing straight into the destination buffer.
+// Literal/length codes are looked up in an 11-bit table where two short literals share one entry,
+// matches are copied 8, 16 or 32 bytes at a time while the destination has room for the overshoot.
+class DeflateDecoder {
+public:
+    enum class BlockType : uint8_t {
+        STORED = 0,
+        STATIC_HUFFMAN = 1,
+        DYNAMIC_HUFFMAN = 2
+    };
+
+    // size of the sliding window, the farthest a match may refer back
+    static constexpr size_t WINDOW_SIZE = 32768;
+    // symbols from `MARKER_BASE` on stand for bytes of an unknown window, see `decode_block_symbols`
+    static constexpr uint16_t MARKER_BASE = 256;
+
+    DeflateDecoder();
+
+    // decodes blocks until the final one, returns the number of bytes written to `dest`;
+    // throws `error::invalid_inflate_data` on malformed data and `error::unexpected_inflated_size`
+    // when the stream holds more data than `dest` can fit
+    size_t decode(InputBitStream& in, std::span<uint8_t> dest);
+
+    // Block-level interface, used to decode a stream from the middle (see `SpeculativeInflater`).
+
+    // cheap test whether a dynamic or stored block header may start at the current position, consumes input;
+    // it rejects most positions which are not block boundaries without building any table
+    static bool is_block_start_candidate(InputBitStream& in);
+    // reads the block header and the code tables of a dynamic block, `is_final` is set for the last block
+    BlockType read_block_header(InputBitStream& in, bool& is_final);
+    // decodes the body of the block whose header was read last into [out, out_end),
+    // matches may refer back to `out_begin`; throws like `decode`
+    void decode_block(InputBitStream& in, BlockType type, uint8_t* out_begin, uint8_t*& out, uint8_t* out_end);
+    // decodes the body of the block whose header was read last as 16-bit symbols appended to `out`;
+    // when `allow_markers` is set, matches reaching up to `WINDOW_SIZE` bytes before the start of `out`
+    // produce `MARKER_BASE + i` for byte `i` of the unknown window preceding `out`.
+    // Throws `error::unexpected_inflated_size` once `out` would exceed `max_size` symbols
+    void decode_block_symbols(InputBitStream& in, BlockType type, std::vector<uint16_t>& out, size_t max_size, bool allow_markers);
+
+private:
+    static constexpr uint32_t LITLEN_TABLE_BITS = 11;
+    static constexpr uint32_t DISTANCE_TABLE_BITS = 8;
+    static constexpr uint32_t PRECODE_TABLE_BITS = 7;
+    static constexpr size_t MAX_LITLEN_SYMBOLS = 288;
+    static constexpr size_t MAX_DISTANCE_SYMBOLS = 32;
+    static constexpr size_t PRECODE_SYMBOLS = 19;
+    // bytes a wide match copy may write past the end of the match
+    static constexpr size_t WIDE_COPY_SLACK = 32;
+    // output room for one iteration of the fast decoding loop
+    static constexpr size_t FASTLOOP_MARGIN = 258 + WIDE_COPY_SLACK + 4;
+
+    HuffmanTable m_litlen;
+    HuffmanTable m_distance;
+    HuffmanTable m_precode;
+    HuffmanTable m_static_litlen;
+    HuffmanTable m_static_distance;
+
+    void build_static_tables();
+    void read_dynamic_tables(InputBitStream& in);
+    static uint32_t read_stored_block_length(InputBitStream& in);
+    void decode_stored_block(InputBitStream& in, uint8_t*& out, uint8_t* out_end);
+    void decode_huffman_block(
+        InputBitStream& in,
+        const HuffmanTable& litlen,
+        const HuffmanTable& distance,
+        uint8_t* out_begin,
+        uint8_t*& out,
+        uint8_t* out_end
+    );
+
+    static bool build_litlen_table(HuffmanTable& table, const uint8_t* lengths, size_t count);
+    static bool build_distance_table(HuffmanTable& table, const uint8_t* lengths, size_t count);
+};
+
+}
@@ -0,0 +1,96 @@
+#include "inflate_backend.h"
+
+// stl includes
+#include <vector>
+#include <memory>
+#include <string>
+
+// custom includes
+#include "../errors.h"
+#include "backend_factories.h"
+
+
+namespace png_decoder::inflater {
+
+    Backend default_backend() noexcept {
+#if defined(PNG_DECODER_WITH_LIBDEFLATE)
+        return Backend::LIBDEFLATE;
+#elif defined(PNG_DECODER_WITH_ZLIB_NG)
+        return Backend::ZLIB_NG;
+#else
+        // the in-house decoder is opt-in, zlib stays the fallback for untrusted input
+        return Backend::ZLIB;
+#endif
+    }
+
+    bool is_backend_available(Backend backend) noexcept {
+        switch (backend) {
+            case Backend::ZLIB:
+            case Backend::NATIVE:
+                return true;
+            case Backend::ZLIB_NG:
+#ifdef PNG_DECODER_WITH_ZLIB_NG
+                return true;
+#else
+                return false;
+#endif
+            case Backend::LIBDEFLATE:
+#ifdef PNG_DECODER_WITH_LIBDEFLATE
+                return true;
+#else
+                return false;
+#endif
+        }
+        return false;
+    }
+
+    std::vector<Backend> available_backends() {
+        std::vector<Backend> result;
+        for (Backend backend : { Backend::ZLIB, Backend::ZLIB_NG, Backend::LIBDEFLATE, Backend::NATIVE }) {
+            if (is_backend_available(backend)) {
+                result.push_back(backend);
+            }
+        }
+        return result;
+    }
+
+    std::string to_string(Backend backend) {
+        switch (backend) {
+            case Backend::ZLIB:
+                return "zlib";
+            case Backend::ZLIB_NG:
+                return "zlib-ng";
+            case Backend::LIBDEFLATE:
+                return "libdeflate";
+            case Backend::NATIVE:
+                return "native";
+        }
+        return "unknown (" + std::to_string(static_cast<int>(backend)) + ")";
+    }
+
+    std::unique_ptr<InflateBackend> InflateBackend::create_backend(Backend backend, std::pmr::memory_resource* resource) {
+        switch (backend) {
+            case Backend::ZLIB: {
+                return create_zlib_backend(resource);
+            }
+            case Backend::NATIVE: {
+                return create_native_backend();
+            }
+#ifdef PNG_DECODER_WITH_ZLIB_NG
+            case Backend::ZLIB_NG: {
+                return create_zlib_ng_backend(resource);
+            }
+#endif
+#ifdef PNG_DECODER_WITH_LIBDEFLATE
+            case Backend::LIBDEFLATE: {
+                return create_libdeflate_backend();
+            }
+#endif
+            default:
+                break;
+        }
+
+        throw error::unavailable_backend(to_string(backend));
+    }
+
+}
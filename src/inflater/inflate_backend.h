@@ -0,0 +1,45 @@
+#pragma once
+
+// stl includes
+#include <vector>
+#include <span>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <cstdint>
+
+// custom includes
+
+
+
+namespace png_decoder::inflater {
+
+enum class Backend : uint8_t {
+    ZLIB = 0,
+    ZLIB_NG = 1,
+    LIBDEFLATE = 2,
+    NATIVE = 3
+};
+
+// fastest optional library compiled in (libdeflate, then zlib-ng), zlib otherwise; `NATIVE` is never the default
+Backend default_backend() noexcept;
+// whether the backend was enabled at build time
+bool is_backend_available(Backend backend) noexcept;
+std::vector<Backend> available_backends();
+std::string to_string(Backend backend);
+
+
+class InflateBackend {
+public:
+    // `resource`, when given, backs the internal state of backends with a custom allocator hook (zlib, zlib-ng)
+    static std::unique_ptr<InflateBackend> create_backend(Backend backend, std::pmr::memory_resource* resource = nullptr);
+
+    /*
+    Decompress the zlib stream formed by concatenation of `sources` directly into `dest`.
+    `dest` must have the exact size of the inflated data, otherwise `error::unexpected_inflated_size` is thrown.
+    */
+    virtual void inflate(const std::vector<std::span<const uint8_t>>& sources, std::span<uint8_t> dest) = 0;
+    virtual ~InflateBackend() = default;
+};
+
+}
@@ -2,10 +2,14 @@
 
 // stl includes
 #include <vector>
+#include <span>
+#include <memory>
+#include <memory_resource>
 #include <cstdint>
-#include <zlib.h>
 
 // custom includes
+#include "inflate_backend.h"
+#include "speculative_inflater.h"
 
 
 
@@ -13,35 +17,30 @@ namespace png_decoder::inflater {
 
 class Inflater {
 public:
-    Inflater();
-    ~Inflater();
+    // `resource` must outlive the inflater, zlib keeps its state in it between calls
+    explicit Inflater(Backend backend = default_backend(), std::pmr::memory_resource* resource = nullptr);
 
-    std::vector<uint8_t> inflate(const std::vector<uint8_t>& source);
-
-private:
-    inline static const size_t CHUNK_SIZE = 16384;
-    z_stream m_stream;
+    // inflates a single zlib stream split across several buffers (e.g. IDAT chunks) into a caller-provided buffer
+    // which size is the exact expected size of the inflated data,
+    // throws if the stream produces less or more bytes than `dest` holds
+    void inflate(const std::vector<std::span<const uint8_t>>& sources, std::span<uint8_t> dest);
 
+    Backend get_backend() const noexcept;
 
-    /*
-    Decompress from `source` to `dest`.
-    returns
-    - Z_OK on success
-    - Z_MEM_ERROR if memory could not be allocated for processing
-    - Z_DATA_ERROR if the deflate data is invalid or incomplete
-    - Z_VERSION_ERROR if the version of zlib.h and the version of the library linked do not match.
-    */
-    int inflate_impl(const std::vector<uint8_t>& source, std::vector<uint8_t>& dest);
+    // experimental: streams of at least `min_compressed_size` bytes are inflated by `SpeculativeInflater`
+    // with `thread_count` threads instead of the backend, in `max_memory` bytes besides `dest` (see
+    // `SpeculativeInflater::working_set_size`), or by the backend when that is not enough;
+    // a `thread_count` below 2 turns it off
+    void set_speculative_inflate(uint32_t thread_count, size_t min_compressed_size, uint64_t max_memory);
 
-    int init_stream();
-    
-    void validate_inflate_status(int ret);
-    
-    std::size_t read_from_vector(unsigned char* buffer, size_t buffer_size, const std::vector<uint8_t>& source, size_t start);
-    
-    void insert_inflated_bytes(const unsigned char* buffer, size_t have, std::vector<uint8_t>& dest);
+private:
+    Backend m_backend;
+    std::unique_ptr<InflateBackend> m_impl;
+    std::unique_ptr<SpeculativeInflater> m_speculative;
+    size_t m_speculative_min_size;
+    uint64_t m_speculative_max_memory;
 };
 
     
 
-}
\ No newline at end of file
+}
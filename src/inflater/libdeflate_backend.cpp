@@ -0,0 +1,74 @@
+#include "libdeflate_backend.h"
+
+// stl includes
+#include <vector>
+#include <cstdint>
+#include <string>
+#include <libdeflate.h>
+
+// custom includes
+#include "../errors.h"
+#include "backend_factories.h"
+
+
+namespace png_decoder::inflater {
+
+    LibdeflateBackend::LibdeflateBackend() : m_decompressor(libdeflate_alloc_decompressor()) {
+        if (m_decompressor == nullptr) {
+            throw error::out_of_memory();
+        }
+    }
+
+    LibdeflateBackend::~LibdeflateBackend() {
+        libdeflate_free_decompressor(m_decompressor);
+    }
+
+    void LibdeflateBackend::inflate(const std::vector<std::span<const uint8_t>>& sources, std::span<uint8_t> dest) {
+        std::span<const uint8_t> source = contiguous_source(sources);
+
+        // without `actual_out_nbytes_ret` libdeflate requires the output to fill `dest` exactly
+        libdeflate_result ret = libdeflate_zlib_decompress(
+            m_decompressor,
+            source.data(),
+            source.size(),
+            dest.data(),
+            dest.size(),
+            nullptr
+        );
+
+        switch (ret) {
+            case LIBDEFLATE_SUCCESS:
+                return;
+            case LIBDEFLATE_SHORT_OUTPUT:
+                throw error::unexpected_inflated_size("inflated data is shorter than expected " + std::to_string(dest.size()) + " bytes");
+            case LIBDEFLATE_INSUFFICIENT_SPACE:
+                throw error::unexpected_inflated_size("inflated data exceeds expected " + std::to_string(dest.size()) + " bytes");
+            default:
+                throw error::invalid_inflate_data();
+        }
+    }
+
+    std::span<const uint8_t> LibdeflateBackend::contiguous_source(const std::vector<std::span<const uint8_t>>& sources) {
+        if (sources.size() == 1) {
+            return sources.front();
+        }
+
+        size_t total_size = 0;
+        for (const auto& source : sources) {
+            total_size += source.size();
+        }
+
+        m_merged_sources.clear();
+        m_merged_sources.reserve(total_size);
+        for (const auto& source : sources) {
+            m_merged_sources.insert(m_merged_sources.end(), source.begin(), source.end());
+        }
+
+        return m_merged_sources;
+    }
+
+    std::unique_ptr<InflateBackend> create_libdeflate_backend() {
+        return std::make_unique<LibdeflateBackend>();
+    }
+
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+// stl includes
+#include <vector>
+#include <span>
+#include <cstdint>
+
+// custom includes
+#include "inflate_backend.h"
+
+
+struct libdeflate_decompressor;
+
+namespace png_decoder::inflater {
+
+// whole-buffer decompressor: the stream must be contiguous, so a stream split
+// across several sources is merged into a reusable buffer first
+class LibdeflateBackend : public InflateBackend {
+public:
+    LibdeflateBackend();
+    ~LibdeflateBackend() override;
+
+    LibdeflateBackend(const LibdeflateBackend&) = delete;
+    LibdeflateBackend& operator=(const LibdeflateBackend&) = delete;
+
+    void inflate(const std::vector<std::span<const uint8_t>>& sources, std::span<uint8_t> dest) override;
+
+private:
+    libdeflate_decompressor* m_decompressor;
+    std::vector<uint8_t> m_merged_sources;
+
+    std::span<const uint8_t> contiguous_source(const std::vector<std::span<const uint8_t>>& sources);
+};
+
+}
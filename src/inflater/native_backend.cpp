@@ -0,0 +1,67 @@
+#include "native_backend.h"
+
+// stl includes
+#include <vector>
+#include <cstdint>
+#include <string>
+#include <zlib.h>
+
+// custom includes
+#include "../errors.h"
+#include "backend_factories.h"
+
+
+namespace png_decoder::inflater {
+
+    void NativeBackend::inflate(const std::vector<std::span<const uint8_t>>& sources, std::span<uint8_t> dest) {
+        deflate::InputBitStream in(sources);
+
+        read_zlib_header(in);
+        size_t inflated_bytes_count = m_decoder.decode(in, dest);
+        uint32_t expected_checksum = read_zlib_trailer(in);
+
+        // like zlib, the checksum of the bytes inflated is verified before their count
+        if (in.is_overread()) {
+            throw error::invalid_inflate_data();
+        }
+        if (adler32_z(adler32_z(0, Z_NULL, 0), dest.data(), inflated_bytes_count) != expected_checksum) {
+            throw error::invalid_inflate_data();
+        }
+        if (inflated_bytes_count != dest.size()) {
+            throw error::unexpected_inflated_size(
+                "expected " + std::to_string(dest.size()) + " bytes, but inflated " + std::to_string(inflated_bytes_count)
+            );
+        }
+    }
+
+    void NativeBackend::read_zlib_header(deflate::InputBitStream& in) {
+        in.refill();
+        uint32_t cmf = in.pop(8);
+        uint32_t flg = in.pop(8);
+
+        bool is_deflate = (cmf & 0x0f) == 8 && (cmf >> 4) <= 7;
+        bool is_check_valid = ((cmf << 8) | flg) % 31 == 0;
+        bool has_dictionary = (flg & 0x20) != 0;
+
+        if (!is_deflate || !is_check_valid || has_dictionary) {
+            throw error::invalid_inflate_data();
+        }
+    }
+
+    uint32_t NativeBackend::read_zlib_trailer(deflate::InputBitStream& in) {
+        // adler-32 of the inflated data, stored big-endian after the last block
+        in.align_to_byte();
+        in.refill();
+
+        uint32_t checksum = 0;
+        for (int i = 0; i < 4; ++i) {
+            checksum = (checksum << 8) | in.pop(8);
+        }
+        return checksum;
+    }
+
+    std::unique_ptr<InflateBackend> create_native_backend() {
+        return std::make_unique<NativeBackend>();
+    }
+
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+// stl includes
+#include <vector>
+#include <span>
+#include <cstdint>
+
+// custom includes
+#include "inflate_backend.h"
+#include "deflate_decoder.h"
+
+
+
+namespace png_decoder::inflater {
+
+// in-house zlib (RFC 1950) decoder on top of `deflate::DeflateDecoder`, has no external dependencies
+class NativeBackend : public InflateBackend {
+public:
+    void inflate(const std::vector<std::span<const uint8_t>>& sources, std::span<uint8_t> dest) override;
+
+private:
+    deflate::DeflateDecoder m_decoder;
+
+    static void read_zlib_header(deflate::InputBitStream& in);
+    static uint32_t read_zlib_trailer(deflate::InputBitStream& in);
+};
+
+}
@@ -0,0 +1,191 @@
+#include "segment_inflater.h"
+
+// stl includes
+#include <vector>
+#include <cstdint>
+#include <string>
+#include <algorithm>
+#include <zlib.h>
+
+// custom includes
+#include "../errors.h"
+
+
+namespace png_decoder::inflater {
+
+    namespace {
+        constexpr size_t ZLIB_HEADER_SIZE = 2;
+        constexpr size_t ZLIB_TRAILER_SIZE = 4;
+    }
+
+    SegmentInflater::SegmentInflater() : m_stream{}, m_is_stream_initialized(false) {}
+
+    SegmentInflater::~SegmentInflater() {
+        if (m_is_stream_initialized) {
+            static_cast<void>(inflateEnd(&m_stream));
+        }
+    }
+
+    SegmentInflater::Result SegmentInflater::inflate(
+        const std::vector<std::span<const uint8_t>>& sources,
+        std::span<uint8_t> dest,
+        bool is_first,
+        bool is_last
+    ) {
+        init_stream();
+
+        std::vector<std::span<const uint8_t>> deflate_sources;
+        if (is_first) {
+            validate_zlib_header(sources);
+            deflate_sources = skip_bytes(sources, ZLIB_HEADER_SIZE);
+        }
+        else {
+            deflate_sources = sources;
+        }
+
+        // after `dest` is full the output goes to a single spare byte, anything written there means the segment is too long
+        unsigned char overflow_byte;
+        size_t out_left = dest.size();
+        m_stream.next_out = dest.empty() ? &overflow_byte : dest.data();
+        m_stream.avail_out = 0;
+
+        int ret = Z_OK;
+        size_t source_index = 0;
+
+        for (; source_index < deflate_sources.size() && ret != Z_STREAM_END; ++source_index) {
+            const auto& source = deflate_sources[source_index];
+            m_stream.next_in = const_cast<Bytef*>(source.data());
+            m_stream.avail_in = source.size();
+
+            while (m_stream.avail_in > 0) {
+                if (m_stream.avail_out == 0) {
+                    if (out_left == 0) {
+                        if (m_stream.next_out == &overflow_byte + 1) {
+                            throw error::unexpected_inflated_size("segment inflates to more than " + std::to_string(dest.size()) + " bytes");
+                        }
+                        m_stream.next_out = &overflow_byte;
+                        m_stream.avail_out = 1;
+                    }
+                    else {
+                        m_stream.avail_out = static_cast<uInt>(std::min<size_t>(out_left, MAX_AVAIL_OUT));
+                        out_left -= m_stream.avail_out;
+                    }
+                }
+
+                ret = ::inflate(&m_stream, Z_NO_FLUSH);
+
+                if (ret == Z_STREAM_END) {
+                    break;
+                }
+                if (ret != Z_OK && ret != Z_BUF_ERROR) {
+                    throw error::invalid_inflate_data();
+                }
+            }
+        }
+
+        if (m_stream.next_out == &overflow_byte + 1) {
+            throw error::unexpected_inflated_size("segment inflates to more than " + std::to_string(dest.size()) + " bytes");
+        }
+
+        size_t inflated_bytes_count = dest.size() - out_left - (m_stream.next_out == &overflow_byte ? 0 : m_stream.avail_out);
+        if (inflated_bytes_count != dest.size()) {
+            throw error::unexpected_inflated_size(
+                "expected segment of " + std::to_string(dest.size()) + " bytes, but inflated " + std::to_string(inflated_bytes_count)
+            );
+        }
+
+        // only the last segment may hold the final block
+        if ((ret == Z_STREAM_END) != is_last) {
+            throw error::invalid_inflate_data();
+        }
+
+        Result result{ static_cast<uint32_t>(adler32_z(adler32_z(0, Z_NULL, 0), dest.data(), dest.size())), 0 };
+
+        if (is_last) {
+            // the rest of the input is exactly the big-endian adler-32 trailer
+            std::vector<uint8_t> trailer(m_stream.next_in, m_stream.next_in + m_stream.avail_in);
+            for (; source_index < deflate_sources.size(); ++source_index) {
+                trailer.insert(trailer.end(), deflate_sources[source_index].begin(), deflate_sources[source_index].end());
+            }
+
+            if (trailer.size() != ZLIB_TRAILER_SIZE) {
+                throw error::invalid_inflate_data();
+            }
+            for (uint8_t byte : trailer) {
+                result.expected_stream_checksum = (result.expected_stream_checksum << 8) | byte;
+            }
+        }
+
+        return result;
+    }
+
+    uint32_t SegmentInflater::combine_checksums(uint32_t first, uint32_t second, size_t second_length) {
+        return static_cast<uint32_t>(adler32_combine(first, second, static_cast<z_off_t>(second_length)));
+    }
+
+    void SegmentInflater::init_stream() {
+        m_stream.avail_in = 0;
+        m_stream.next_in = Z_NULL;
+
+        if (m_is_stream_initialized) {
+            if (inflateReset(&m_stream) != Z_OK) {
+                throw error::invalid_inflate_data();
+            }
+            return;
+        }
+
+        m_stream.zalloc = Z_NULL;
+        m_stream.zfree = Z_NULL;
+        m_stream.opaque = Z_NULL;
+
+        // negative window bits: raw deflate, the zlib header and trailer are handled here
+        int ret = inflateInit2(&m_stream, -MAX_WBITS);
+        if (ret == Z_MEM_ERROR) {
+            throw error::out_of_memory();
+        }
+        if (ret == Z_VERSION_ERROR) {
+            throw error::version_lib_mismatch();
+        }
+        if (ret != Z_OK) {
+            throw error::invalid_compression_level();
+        }
+        m_is_stream_initialized = true;
+    }
+
+    std::vector<std::span<const uint8_t>> SegmentInflater::skip_bytes(const std::vector<std::span<const uint8_t>>& sources, size_t count) {
+        std::vector<std::span<const uint8_t>> result;
+        for (const auto& source : sources) {
+            size_t skipped = std::min(count, source.size());
+            count -= skipped;
+            if (skipped < source.size()) {
+                result.push_back(source.subspan(skipped));
+            }
+        }
+        return result;
+    }
+
+    void SegmentInflater::validate_zlib_header(const std::vector<std::span<const uint8_t>>& sources) {
+        uint8_t header[ZLIB_HEADER_SIZE];
+        size_t read = 0;
+        for (const auto& source : sources) {
+            for (size_t i = 0; i < source.size() && read < ZLIB_HEADER_SIZE; ++i) {
+                header[read++] = source[i];
+            }
+        }
+
+        if (read < ZLIB_HEADER_SIZE) {
+            throw error::invalid_inflate_data();
+        }
+
+        uint32_t cmf = header[0];
+        uint32_t flg = header[1];
+        bool is_deflate = (cmf & 0x0f) == 8 && (cmf >> 4) <= 7;
+        bool is_check_valid = ((cmf << 8) | flg) % 31 == 0;
+        bool has_dictionary = (flg & 0x20) != 0;
+
+        if (!is_deflate || !is_check_valid || has_dictionary) {
+            throw error::invalid_inflate_data();
+        }
+    }
+
+}
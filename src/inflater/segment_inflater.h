@@ -0,0 +1,57 @@
+#pragma once
+
+// stl includes
+#include <vector>
+#include <span>
+#include <cstdint>
+#include <limits>
+#include <zlib.h>
+
+// custom includes
+
+
+
+namespace png_decoder::inflater {
+
+// Inflates one segment of a zlib stream whose encoder issued a full flush at the segment start
+// (e.g. the parts announced by Apple's iDOT chunk). Such a segment starts at a byte-aligned block boundary
+// and never references earlier output, so the segments of one stream can be inflated on separate threads.
+// One instance must not be used by two threads at the same time.
+class SegmentInflater {
+public:
+    struct Result {
+        // adler-32 of the inflated segment
+        uint32_t checksum;
+        // adler-32 trailer of the whole stream, read by the last segment only
+        uint32_t expected_stream_checksum;
+    };
+
+    SegmentInflater();
+    ~SegmentInflater();
+
+    SegmentInflater(const SegmentInflater&) = delete;
+    SegmentInflater& operator=(const SegmentInflater&) = delete;
+
+    /*
+    Inflates the segment formed by concatenation of `sources` into `dest` of the exact segment size.
+    The first segment begins with the zlib header, the last one holds the final block followed by the adler-32 trailer,
+    other segments must end without a final block.
+    Throws `error::invalid_inflate_data` or `error::unexpected_inflated_size`.
+    */
+    Result inflate(const std::vector<std::span<const uint8_t>>& sources, std::span<uint8_t> dest, bool is_first, bool is_last);
+
+    // adler-32 of two consecutive buffers from their checksums
+    static uint32_t combine_checksums(uint32_t first, uint32_t second, size_t second_length);
+
+private:
+    inline static const size_t MAX_AVAIL_OUT = std::numeric_limits<uInt>::max();
+    z_stream m_stream;
+    bool m_is_stream_initialized;
+
+    void init_stream();
+    // drops `count` leading bytes of the stream, returns the remaining sources
+    static std::vector<std::span<const uint8_t>> skip_bytes(const std::vector<std::span<const uint8_t>>& sources, size_t count);
+    static void validate_zlib_header(const std::vector<std::span<const uint8_t>>& sources);
+};
+
+}
@@ -0,0 +1,324 @@
+#include "speculative_inflater.h"
+
+// stl includes
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <algorithm>
+#include <future>
+#include <zlib.h>
+
+// custom includes
+#include "../errors.h"
+
+
+namespace png_decoder::inflater {
+
+    namespace {
+        using deflate::DeflateDecoder;
+
+        constexpr size_t ZLIB_HEADER_BITS = 16;
+        // initial room of the byte buffer of a range, it doubles when a block does not fit
+        constexpr size_t INITIAL_RANGE_CAPACITY = 256 * 1024;
+
+        void validate_zlib_header(deflate::InputBitStream& in) {
+            in.refill();
+            uint32_t cmf = in.pop(8);
+            uint32_t flg = in.pop(8);
+
+            bool is_deflate = (cmf & 0x0f) == 8 && (cmf >> 4) <= 7;
+            bool is_check_valid = ((cmf << 8) | flg) % 31 == 0;
+            bool has_dictionary = (flg & 0x20) != 0;
+
+            if (!is_deflate || !is_check_valid || has_dictionary) {
+                throw error::invalid_inflate_data();
+            }
+        }
+
+        bool has_markers(const std::vector<uint16_t>& symbols, size_t first) {
+            return std::any_of(symbols.begin() + first, symbols.end(), [](uint16_t symbol) {
+                return symbol >= DeflateDecoder::MARKER_BASE;
+            });
+        }
+    }
+
+    SpeculativeInflater::SpeculativeInflater(uint32_t thread_count) : m_thread_count(std::max(1u, thread_count)) {
+        for (uint32_t i = 0; i < m_thread_count; ++i) {
+            m_decoders.push_back(std::make_unique<DeflateDecoder>());
+        }
+    }
+
+    uint32_t SpeculativeInflater::get_thread_count() const noexcept {
+        return m_thread_count;
+    }
+
+    uint64_t SpeculativeInflater::working_set_size(uint64_t inflated_size, uint32_t thread_count) {
+        thread_count = std::max(1u, thread_count);
+        uint64_t share = (inflated_size + thread_count - 1) / thread_count;
+        return thread_count * (4 * share + 2 * (DeflateDecoder::WINDOW_SIZE + INITIAL_RANGE_CAPACITY));
+    }
+
+    size_t SpeculativeInflater::Range::output_size() const noexcept {
+        return symbols.size() + bytes_size - window_size;
+    }
+
+    bool SpeculativeInflater::inflate(const std::vector<std::span<const uint8_t>>& sources, std::span<uint8_t> dest, uint64_t max_memory) {
+        uint64_t total_bytes = 0;
+        for (const auto& source : sources) {
+            total_bytes += source.size();
+        }
+
+        deflate::InputBitStream in(sources);
+        validate_zlib_header(in);
+
+        // equal ranges of the deflate data, the first one starts right after the zlib header
+        uint64_t total_bits = total_bytes * 8;
+        size_t ranges_count = m_thread_count;
+        std::vector<uint64_t> bounds(ranges_count + 1);
+        for (size_t i = 0; i <= ranges_count; ++i) {
+            bounds[i] = ZLIB_HEADER_BITS + (total_bits - std::min(total_bits, uint64_t(ZLIB_HEADER_BITS))) * i / ranges_count / 8 * 8;
+        }
+        bounds[ranges_count] = total_bits;
+        size_t range_memory = static_cast<size_t>(std::min<uint64_t>(max_memory / ranges_count, SIZE_MAX));
+
+        // every range but the first is guessed on its own thread
+        std::vector<std::future<Range>> speculated;
+        for (size_t i = 1; i < ranges_count; ++i) {
+            speculated.push_back(std::async(std::launch::async, [&, i]() {
+                deflate::InputBitStream range_in(sources);
+                return speculate_range(*m_decoders[i], range_in, bounds[i], bounds[i + 1], dest.size(), range_memory);
+            }));
+        }
+
+        // the first range starts at a known boundary with an empty window
+        Range range = decode_range(*m_decoders[0], in, ZLIB_HEADER_BITS, bounds[1], dest.size(), range_memory, false);
+        size_t offset = 0;
+
+        for (size_t i = 0; ; ++i) {
+            if (!range.is_decoded) {
+                // the range outgrew its share of the memory
+                return false;
+            }
+            if (range.output_size() > dest.size() - offset) {
+                // decoded again with the room left, so that corrupt data before the overrun is reported first
+                // like a serial inflate does
+                if (!decode_range(*m_decoders[0], in, range.start_bit, bounds[i + 1], dest.size() - offset, range_memory, i > 0).is_decoded) {
+                    return false;
+                }
+                throw error::unexpected_inflated_size("inflated data exceeds expected " + std::to_string(dest.size()) + " bytes");
+            }
+            resolve_range(range, dest, offset);
+            offset += range.output_size();
+
+            if (range.is_final) {
+                break;
+            }
+            if (i + 1 >= ranges_count) {
+                // the final block lies past the end of input
+                throw error::invalid_inflate_data();
+            }
+
+            uint64_t end_bit = range.end_bit;
+            Range next = speculated[i].get();
+            if (next.is_decoded && next.start_bit == end_bit) {
+                range = std::move(next);
+            }
+            else {
+                // the guess missed the real block boundary, the range is decoded again from there
+                range = decode_range(*m_decoders[0], in, end_bit, bounds[i + 2], dest.size() - offset, range_memory, true);
+            }
+        }
+
+        // remaining guesses are not needed, but their threads have to finish before the decoders go away
+        for (auto& future : speculated) {
+            if (future.valid()) {
+                future.wait();
+            }
+        }
+
+        // adler-32 trailer after the final block
+        in.seek(range.end_bit);
+        in.align_to_byte();
+        in.refill();
+        uint32_t expected_checksum = 0;
+        for (int i = 0; i < 4; ++i) {
+            expected_checksum = (expected_checksum << 8) | in.pop(8);
+        }
+
+        // the checksum of the bytes inflated is verified before their count, as by the serial backends
+        if (in.is_overread()) {
+            throw error::invalid_inflate_data();
+        }
+        if (adler32_z(adler32_z(0, Z_NULL, 0), dest.data(), offset) != expected_checksum) {
+            throw error::invalid_inflate_data();
+        }
+        if (offset != dest.size()) {
+            throw error::unexpected_inflated_size(
+                "expected " + std::to_string(dest.size()) + " bytes, but inflated " + std::to_string(offset)
+            );
+        }
+        return true;
+    }
+
+    SpeculativeInflater::Range SpeculativeInflater::decode_range(
+        DeflateDecoder& decoder,
+        deflate::InputBitStream& in,
+        uint64_t start_bit,
+        uint64_t stop_bit,
+        size_t max_output,
+        size_t max_memory,
+        bool allow_markers
+    ) {
+        Range range;
+        range.start_bit = start_bit;
+        in.seek(start_bit);
+
+        // the symbols vector may take twice their count, the byte buffer gets what the symbols leave
+        size_t max_symbols = max_memory / (2 * sizeof(uint16_t));
+        auto fits_bytes = [&](size_t size) {
+            return range.symbols.capacity() * sizeof(uint16_t) + size <= max_memory;
+        };
+
+        // without an unknown window bytes are decoded straight away
+        bool is_byte_mode = !allow_markers;
+        // symbols after the last marker, once they cover a whole window no marker can appear anymore
+        size_t clean_symbols_begin = 0;
+
+        while (true) {
+            uint64_t block_start = in.position();
+            bool is_final = false;
+            auto type = decoder.read_block_header(in, is_final);
+
+            if (!is_byte_mode) {
+                size_t block_begin = range.symbols.size();
+                try {
+                    decoder.decode_block_symbols(in, type, range.symbols, std::min(max_output, max_symbols), true);
+                }
+                catch (const error::unexpected_inflated_size&) {
+                    if (max_symbols >= max_output) {
+                        throw;
+                    }
+                    // outgrew its share of the memory
+                    return Range{};
+                }
+
+                if (has_markers(range.symbols, std::max(block_begin, clean_symbols_begin))) {
+                    auto last_marker = std::find_if(range.symbols.rbegin(), range.symbols.rend(), [](uint16_t symbol) {
+                        return symbol >= DeflateDecoder::MARKER_BASE;
+                    });
+                    clean_symbols_begin = range.symbols.rend() - last_marker;
+                }
+
+                if (range.symbols.size() - clean_symbols_begin >= DeflateDecoder::WINDOW_SIZE) {
+                    // the window is known from here on, the last 32 KiB of symbols seed the byte buffer
+                    if (!fits_bytes(DeflateDecoder::WINDOW_SIZE + INITIAL_RANGE_CAPACITY)) {
+                        return Range{};
+                    }
+                    is_byte_mode = true;
+                    range.window_size = DeflateDecoder::WINDOW_SIZE;
+                    range.bytes.resize(range.window_size + INITIAL_RANGE_CAPACITY);
+                    std::copy(range.symbols.end() - range.window_size, range.symbols.end(), range.bytes.begin());
+                    range.bytes_size = range.window_size;
+                }
+            }
+            else {
+                if (range.bytes.empty()) {
+                    if (!fits_bytes(INITIAL_RANGE_CAPACITY)) {
+                        return Range{};
+                    }
+                    range.bytes.resize(INITIAL_RANGE_CAPACITY);
+                }
+
+                while (true) {
+                    uint8_t* out = range.bytes.data() + range.bytes_size;
+                    try {
+                        decoder.decode_block(in, type, range.bytes.data(), out, range.bytes.data() + range.bytes.size());
+                        range.bytes_size = out - range.bytes.data();
+                        break;
+                    }
+                    catch (const error::unexpected_inflated_size&) {
+                        if (range.output_size() + (range.bytes.size() - range.bytes_size) >= max_output) {
+                            throw;
+                        }
+                        // the block did not fit, it is decoded again into a larger buffer
+                        if (!fits_bytes(range.bytes.size() * 2)) {
+                            return Range{};
+                        }
+                        range.bytes.resize(range.bytes.size() * 2);
+                        in.seek(block_start);
+                        type = decoder.read_block_header(in, is_final);
+                    }
+                }
+            }
+
+            if (in.is_overread()) {
+                throw error::invalid_inflate_data();
+            }
+            if (range.output_size() > max_output) {
+                throw error::unexpected_inflated_size("inflated data exceeds expected " + std::to_string(max_output) + " bytes");
+            }
+
+            if (is_final || in.position() >= stop_bit) {
+                range.is_final = is_final;
+                range.end_bit = in.position();
+                break;
+            }
+        }
+
+        range.is_decoded = true;
+        return range;
+    }
+
+    SpeculativeInflater::Range SpeculativeInflater::speculate_range(
+        DeflateDecoder& decoder,
+        deflate::InputBitStream& in,
+        uint64_t first_bit,
+        uint64_t stop_bit,
+        size_t max_output,
+        size_t max_memory
+    ) {
+        for (uint64_t bit = first_bit; bit < stop_bit; ++bit) {
+            // static blocks are too likely to match by chance, only dynamic and stored ones are tried
+            in.seek(bit);
+            if (!DeflateDecoder::is_block_start_candidate(in)) {
+                continue;
+            }
+
+            try {
+                return decode_range(decoder, in, bit, stop_bit, max_output, max_memory, true);
+            }
+            catch (const std::runtime_error&) {
+                // not a block boundary
+            }
+        }
+
+        return Range{};
+    }
+
+    void SpeculativeInflater::resolve_range(const Range& range, std::span<uint8_t> dest, size_t offset) {
+        uint8_t* out = dest.data() + offset;
+
+        for (size_t i = 0; i < range.symbols.size(); ++i) {
+            uint16_t symbol = range.symbols[i];
+            if (symbol < DeflateDecoder::MARKER_BASE) {
+                out[i] = static_cast<uint8_t>(symbol);
+                continue;
+            }
+
+            // marker of byte `index` of the 32 KiB window preceding the range
+            size_t index = symbol - DeflateDecoder::MARKER_BASE;
+            if (offset + index < DeflateDecoder::WINDOW_SIZE) {
+                // refers to data before the start of the stream
+                throw error::invalid_inflate_data();
+            }
+            out[i] = dest[offset + index - DeflateDecoder::WINDOW_SIZE];
+        }
+
+        size_t bytes_count = range.bytes_size - range.window_size;
+        if (bytes_count > 0) {
+            std::memcpy(out + range.symbols.size(), range.bytes.data() + range.window_size, bytes_count);
+        }
+    }
+
+}
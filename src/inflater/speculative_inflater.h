@@ -0,0 +1,81 @@
+#pragma once
+
+// stl includes
+#include <vector>
+#include <span>
+#include <memory>
+#include <cstdint>
+
+// custom includes
+#include "deflate_decoder.h"
+
+
+
+namespace png_decoder::inflater {
+
+// Experimental parallel inflate of a single zlib stream without restart markers, in the spirit of pugz / rapidgzip.
+// The compressed stream is cut into equal byte ranges. The worker of each range searches for the first bit offset
+// in it where a dynamic or stored block starts and decodes from there to the first block boundary past its range,
+// emitting back-references into the unknown preceding 32 KiB as markers. The ranges are then stitched in order:
+// a range whose guessed start equals the end of the previous one has its markers resolved against the already
+// inflated output, any other range is decoded again from the real boundary. Output is identical to a serial inflate.
+class SpeculativeInflater {
+public:
+    explicit SpeculativeInflater(uint32_t thread_count);
+
+    // inflates the zlib stream formed by concatenation of `sources` into `dest` of the exact inflated size,
+    // throws like `InflateBackend::inflate`. The ranges share `max_memory` bytes equally; returns false when one
+    // outgrows its share, `dest` has to be inflated serially then
+    bool inflate(const std::vector<std::span<const uint8_t>>& sources, std::span<uint8_t> dest, uint64_t max_memory);
+
+    uint32_t get_thread_count() const noexcept;
+
+    // memory which lets the ranges of a stream of `inflated_size` bytes hold their share of the output each,
+    // with room for a range running past its share and for the growth of its buffers
+    static uint64_t working_set_size(uint64_t inflated_size, uint32_t thread_count);
+
+private:
+    // output of the stream between two block boundaries
+    struct Range {
+        bool is_decoded = false;
+        uint64_t start_bit = 0;
+        uint64_t end_bit = 0;
+        bool is_final = false;
+        // symbols up to the point where the last 32 KiB hold no markers
+        std::vector<uint16_t> symbols;
+        // bytes after `symbols`, preceded by `window_size` bytes of window which are not part of the output
+        std::vector<uint8_t> bytes;
+        size_t window_size = 0;
+        size_t bytes_size = 0;
+
+        size_t output_size() const noexcept;
+    };
+
+    uint32_t m_thread_count;
+    std::vector<std::unique_ptr<deflate::DeflateDecoder>> m_decoders;
+
+    // decodes whole blocks from `start_bit` until the final block or the first boundary at or past `stop_bit`,
+    // returns an undecoded range when its buffers would take more than `max_memory` bytes
+    static Range decode_range(
+        deflate::DeflateDecoder& decoder,
+        deflate::InputBitStream& in,
+        uint64_t start_bit,
+        uint64_t stop_bit,
+        size_t max_output,
+        size_t max_memory,
+        bool allow_markers
+    );
+    // tries each bit offset of [first_bit, stop_bit) as a block start, returns an undecoded range when none fits
+    static Range speculate_range(
+        deflate::DeflateDecoder& decoder,
+        deflate::InputBitStream& in,
+        uint64_t first_bit,
+        uint64_t stop_bit,
+        size_t max_output,
+        size_t max_memory
+    );
+    // writes the range output to `dest` at `offset`, markers refer to the 32 KiB before `offset`
+    static void resolve_range(const Range& range, std::span<uint8_t> dest, size_t offset);
+};
+
+}
@@ -0,0 +1,126 @@
+#include "stream_inflater.h"
+
+// stl includes
+#include <vector>
+#include <cstdint>
+#include <string>
+#include <zlib.h>
+
+// custom includes
+#include "../errors.h"
+#include "zlib_allocator.h"
+
+
+namespace png_decoder::inflater {
+
+    StreamInflater::StreamInflater(std::pmr::memory_resource* resource) :
+        m_resource(resource),
+        m_stream{},
+        m_is_stream_initialized(false),
+        m_is_stream_end(false),
+        m_source_index(0) {}
+
+    StreamInflater::~StreamInflater() {
+        if (m_is_stream_initialized) {
+            static_cast<void>(inflateEnd(&m_stream));
+        }
+    }
+
+    void StreamInflater::begin(const std::vector<std::span<const uint8_t>>& sources) {
+        init_stream();
+        m_sources = sources;
+        m_source_index = 0;
+        m_is_stream_end = false;
+    }
+
+    void StreamInflater::read(std::span<uint8_t> dest) {
+        m_stream.next_out = dest.data();
+        m_stream.avail_out = static_cast<uInt>(dest.size());
+
+        while (m_stream.avail_out > 0) {
+            if (m_is_stream_end) {
+                throw error::unexpected_inflated_size("inflated data is shorter than expected, the stream ended after " + std::to_string(m_stream.total_out) + " bytes");
+            }
+            inflate_step();
+        }
+    }
+
+    void StreamInflater::finish() {
+        // anything written to the spare byte means the stream holds more data than was read
+        unsigned char overflow_byte;
+        while (!m_is_stream_end) {
+            m_stream.next_out = &overflow_byte;
+            m_stream.avail_out = 1;
+            inflate_step();
+
+            if (m_stream.avail_out == 0) {
+                throw error::unexpected_inflated_size("inflated data exceeds expected " + std::to_string(m_stream.total_out - 1) + " bytes");
+            }
+        }
+    }
+
+    void StreamInflater::init_stream() {
+        m_stream.avail_in = 0;
+        m_stream.next_in = Z_NULL;
+
+        if (m_is_stream_initialized) {
+            if (inflateReset(&m_stream) != Z_OK) {
+                throw error::invalid_inflate_data();
+            }
+            return;
+        }
+
+        if (m_resource != nullptr) {
+            m_stream.zalloc = zlib_allocator::allocate<uInt>;
+            m_stream.zfree = zlib_allocator::deallocate;
+            m_stream.opaque = m_resource;
+        }
+        else {
+            m_stream.zalloc = Z_NULL;
+            m_stream.zfree = Z_NULL;
+            m_stream.opaque = Z_NULL;
+        }
+
+        int ret = inflateInit(&m_stream);
+        if (ret == Z_MEM_ERROR) {
+            throw error::out_of_memory();
+        }
+        if (ret == Z_VERSION_ERROR) {
+            throw error::version_lib_mismatch();
+        }
+        if (ret != Z_OK) {
+            throw error::invalid_compression_level();
+        }
+        m_is_stream_initialized = true;
+    }
+
+    void StreamInflater::inflate_step() {
+        if (m_stream.avail_in == 0) {
+            if (m_source_index == m_sources.size()) {
+                // the data chunks ended in the middle of the stream
+                throw error::invalid_inflate_data();
+            }
+
+            // zlib never writes through `next_in`, so the source bytes are passed in place
+            const auto& source = m_sources[m_source_index++];
+            m_stream.next_in = const_cast<Bytef*>(source.data());
+            m_stream.avail_in = static_cast<uInt>(source.size());
+            return;
+        }
+
+        int ret = ::inflate(&m_stream, Z_NO_FLUSH);
+        switch (ret) {
+            case Z_OK:
+            case Z_BUF_ERROR:
+                break;
+            case Z_STREAM_END:
+                m_is_stream_end = true;
+                break;
+            case Z_MEM_ERROR:
+                throw error::out_of_memory();
+            default:
+                throw error::invalid_inflate_data();
+        }
+    }
+
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+// stl includes
+#include <vector>
+#include <span>
+#include <memory_resource>
+#include <cstdint>
+#include <zlib.h>
+
+// custom includes
+
+
+
+namespace png_decoder::inflater {
+
+// Inflates a zlib stream split across several buffers (e.g. IDAT chunks) piece by piece into small caller buffers,
+// so the inflated data never has to be held at once; zlib keeps the 32 KiB window of back-references itself.
+// The state is reset, not reallocated, between streams.
+class StreamInflater {
+public:
+    // upper bound of what zlib allocates for its state and window, the memory is taken once and kept
+    const inline static size_t STATE_SIZE = 64 * 1024;
+
+    // `resource`, when given, backs the zlib state through the custom allocator hook, like `ZlibBackend`
+    explicit StreamInflater(std::pmr::memory_resource* resource = nullptr);
+    ~StreamInflater();
+
+    StreamInflater(const StreamInflater&) = delete;
+    StreamInflater& operator=(const StreamInflater&) = delete;
+
+    // starts a new stream, `sources` are viewed in place and must outlive the inflate
+    void begin(const std::vector<std::span<const uint8_t>>& sources);
+
+    /*
+    Fills `dest` with the next inflated bytes.
+    Throws `error::unexpected_inflated_size` when the stream ends before `dest` is full
+    and `error::invalid_inflate_data` when the data is malformed or cut short.
+    */
+    void read(std::span<uint8_t> dest);
+
+    // checks that the stream ends after the bytes read so far, throws `error::unexpected_inflated_size` otherwise
+    void finish();
+
+private:
+    std::pmr::memory_resource* m_resource;
+    z_stream m_stream;
+    bool m_is_stream_initialized;
+    bool m_is_stream_end;
+    std::vector<std::span<const uint8_t>> m_sources;
+    size_t m_source_index;
+
+    void init_stream();
+    // hands the next source to zlib when it ran out of input, otherwise inflates once into `next_out`
+    void inflate_step();
+};
+
+}
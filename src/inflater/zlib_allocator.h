@@ -0,0 +1,49 @@
+#pragma once
+
+// stl includes
+#include <memory_resource>
+#include <cstddef>
+#include <cstdint>
+
+// custom includes
+
+
+
+namespace png_decoder::inflater {
+
+// zlib-style `zalloc`/`zfree` callbacks forwarding to the `std::pmr::memory_resource` passed as `opaque`.
+// zlib does not pass the size to `zfree`, so it is stored in a header in front of each allocation.
+// Works for zlib and zlib-ng alike, both use the same callback signatures up to the integer type of the counts.
+namespace zlib_allocator {
+
+inline constexpr size_t HEADER_SIZE = alignof(std::max_align_t);
+
+template <class Count>
+void* allocate(void* opaque, Count items, Count size) {
+    auto* resource = static_cast<std::pmr::memory_resource*>(opaque);
+    size_t bytes = HEADER_SIZE + static_cast<size_t>(items) * static_cast<size_t>(size);
+
+    try {
+        auto* memory = static_cast<std::byte*>(resource->allocate(bytes, alignof(std::max_align_t)));
+        *reinterpret_cast<size_t*>(memory) = bytes;
+        return memory + HEADER_SIZE;
+    }
+    catch (...) {
+        // zlib expects a null pointer (Z_MEM_ERROR) and must not be unwound through
+        return nullptr;
+    }
+}
+
+inline void deallocate(void* opaque, void* address) {
+    if (address == nullptr) {
+        return;
+    }
+
+    auto* resource = static_cast<std::pmr::memory_resource*>(opaque);
+    auto* memory = static_cast<std::byte*>(address) - HEADER_SIZE;
+    resource->deallocate(memory, *reinterpret_cast<size_t*>(memory), alignof(std::max_align_t));
+}
+
+}
+
+}
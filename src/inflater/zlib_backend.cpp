@@ -0,0 +1,142 @@
+#include "zlib_backend.h"
+
+// stl includes
+#include <vector>
+#include <cstdint>
+#include <string>
+#include <limits>
+#include <algorithm>
+#include <zlib.h>
+
+// custom includes
+#include "../errors.h"
+#include "backend_factories.h"
+#include "zlib_allocator.h"
+
+
+namespace png_decoder::inflater {
+
+    ZlibBackend::ZlibBackend(std::pmr::memory_resource* resource) :
+        m_resource(resource),
+        m_stream{},
+        m_is_stream_initialized(false) {}
+
+    ZlibBackend::~ZlibBackend() {
+        if (m_is_stream_initialized) {
+            static_cast<void>(inflateEnd(&m_stream));
+        }
+    }
+
+    void ZlibBackend::inflate(const std::vector<std::span<const uint8_t>>& sources, std::span<uint8_t> dest) {
+        size_t inflated_bytes_count = 0;
+        int ret = inflate_impl(sources, dest, inflated_bytes_count);
+
+        if (ret == Z_BUF_ERROR) {
+            throw error::unexpected_inflated_size("inflated data exceeds expected " + std::to_string(dest.size()) + " bytes");
+        }
+        validate_inflate_status(ret);
+
+        if (inflated_bytes_count != dest.size()) {
+            throw error::unexpected_inflated_size(
+                "expected " + std::to_string(dest.size()) + " bytes, but inflated " + std::to_string(inflated_bytes_count)
+            );
+        }
+    }
+
+    int ZlibBackend::init_stream() {
+        m_stream.avail_in = 0;
+        m_stream.next_in = Z_NULL;
+
+        if (m_is_stream_initialized) {
+            return inflateReset(&m_stream);
+        }
+
+        if (m_resource != nullptr) {
+            m_stream.zalloc = zlib_allocator::allocate<uInt>;
+            m_stream.zfree = zlib_allocator::deallocate;
+            m_stream.opaque = m_resource;
+        }
+        else {
+            m_stream.zalloc = Z_NULL;
+            m_stream.zfree = Z_NULL;
+            m_stream.opaque = Z_NULL;
+        }
+        int ret = inflateInit(&m_stream);
+        m_is_stream_initialized = (ret == Z_OK);
+        return ret;
+    }
+
+    int ZlibBackend::inflate_impl(const std::vector<std::span<const uint8_t>>& sources, std::span<uint8_t> dest, size_t& inflated_bytes_count) {
+        // initialize stream
+        int ret = init_stream();
+        if (ret != Z_OK) {
+            return ret;
+        }
+
+        // `avail_out` is 32-bit, so larger destinations are handed to zlib in parts
+        unsigned char empty_dest;
+        size_t out_left = dest.size();
+        m_stream.next_out = dest.empty() ? &empty_dest : dest.data();
+        m_stream.avail_out = 0;
+
+        for (const auto& source : sources) {
+            if (source.empty()) {
+                continue;
+            }
+
+            // zlib never writes through `next_in`, so the source bytes are passed in place
+            m_stream.next_in = const_cast<Bytef*>(source.data());
+            m_stream.avail_in = source.size();
+
+            do {
+                if (m_stream.avail_out == 0 && out_left > 0) {
+                    m_stream.avail_out = static_cast<uInt>(std::min<size_t>(out_left, MAX_AVAIL_OUT));
+                    out_left -= m_stream.avail_out;
+                }
+
+                ret = ::inflate(&m_stream, Z_FINISH);
+
+                switch (ret) {
+                    case Z_NEED_DICT:
+                        ret = Z_DATA_ERROR;
+                        [[fallthrough]];
+                    case Z_STREAM_ERROR:
+                    case Z_DATA_ERROR:
+                    case Z_MEM_ERROR:
+                        return ret;
+                }
+
+                if (ret != Z_STREAM_END && m_stream.avail_out == 0 && out_left == 0 && m_stream.avail_in > 0) {
+                    // the destination is full, but the stream still has data to produce
+                    return Z_BUF_ERROR;
+                }
+            } while (ret != Z_STREAM_END && m_stream.avail_in > 0);
+
+            if (ret == Z_STREAM_END) {
+                break;
+            }
+        }
+
+        inflated_bytes_count = dest.size() - out_left - m_stream.avail_out;
+        return ret == Z_STREAM_END ? Z_OK : Z_DATA_ERROR;
+    }
+
+
+    void ZlibBackend::validate_inflate_status(int ret) {
+        switch (ret) {
+            case Z_STREAM_ERROR:
+                throw error::invalid_compression_level();
+            case Z_DATA_ERROR:
+                throw error::invalid_inflate_data();
+            case Z_MEM_ERROR:
+                throw error::out_of_memory();
+            case Z_VERSION_ERROR:
+                throw error::version_lib_mismatch();
+        }
+    }
+
+    std::unique_ptr<InflateBackend> create_zlib_backend(std::pmr::memory_resource* resource) {
+        return std::make_unique<ZlibBackend>(resource);
+    }
+
+}
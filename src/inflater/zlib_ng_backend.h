@@ -0,0 +1,52 @@
+#pragma once
+
+// stl includes
+#include <vector>
+#include <span>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <zlib-ng.h>
+
+// custom includes
+#include "inflate_backend.h"
+
+
+
+namespace png_decoder::inflater {
+
+// zlib-ng built in native mode, its API is prefixed with `zng_` and may coexist with stock zlib
+class ZlibNgBackend : public InflateBackend {
+public:
+    // zlib-ng state is allocated from `resource` when given, otherwise with malloc
+    explicit ZlibNgBackend(std::pmr::memory_resource* resource = nullptr);
+    ~ZlibNgBackend() override;
+
+    void inflate(const std::vector<std::span<const uint8_t>>& sources, std::span<uint8_t> dest) override;
+
+private:
+    inline static const size_t MAX_AVAIL_OUT = std::numeric_limits<uint32_t>::max();
+    std::pmr::memory_resource* m_resource;
+    zng_stream m_stream;
+    bool m_is_stream_initialized;
+
+
+    /*
+    Decompress the stream formed by concatenation of `sources` directly into `dest` with a single `Z_FINISH` pass.
+    `inflated_bytes_count` is set to the number of bytes written to `dest`.
+    returns
+    - Z_OK on success
+    - Z_MEM_ERROR if memory could not be allocated for processing
+    - Z_DATA_ERROR if the deflate data is invalid or incomplete
+    - Z_VERSION_ERROR if the version of zlib-ng.h and the version of the library linked do not match.
+    - Z_BUF_ERROR if the stream holds more data than `dest` can fit
+    */
+    int inflate_impl(const std::vector<std::span<const uint8_t>>& sources, std::span<uint8_t> dest, size_t& inflated_bytes_count);
+
+    // initializes the stream on first use, later calls only reset it, keeping zlib state and window allocated
+    int init_stream();
+    
+    void validate_inflate_status(int ret);
+};
+
+}
@@ -0,0 +1,100 @@
+#include "arena.h"
+
+// stl includes
+#include <new>
+#include <algorithm>
+#include <cstdint>
+
+// custom includes
+
+namespace png_decoder {
+
+    Arena::Arena(size_t block_size, size_t retain_limit) :
+        m_block_size(block_size),
+        m_retain_limit(retain_limit),
+        m_current(nullptr),
+        m_left(0),
+        m_allocated_bytes(0) {}
+
+    Arena::~Arena() {
+        free_blocks();
+    }
+
+    void Arena::release() noexcept {
+        size_t total_size = 0;
+        for (const auto& block : m_blocks) {
+            total_size += block.size;
+        }
+
+        if (m_blocks.size() > 1 || total_size > m_retain_limit) {
+            free_blocks();
+
+            // one block large enough for the whole previous decode
+            if (total_size <= m_retain_limit) {
+                try {
+                    add_block(total_size);
+                }
+                catch (const std::bad_alloc&) {
+                    // the next allocation will retry
+                }
+            }
+        }
+
+        if (!m_blocks.empty()) {
+            m_current = m_blocks.back().memory;
+            m_left = m_blocks.back().size;
+        }
+        m_allocated_bytes = 0;
+    }
+
+    size_t Arena::get_allocated_bytes() const noexcept {
+        return m_allocated_bytes;
+    }
+
+    void* Arena::do_allocate(size_t bytes, size_t alignment) {
+        size_t padding = (alignment - reinterpret_cast<uintptr_t>(m_current) % alignment) % alignment;
+
+        if (m_current == nullptr || padding + bytes > m_left) {
+            add_block(bytes + alignment);
+            padding = (alignment - reinterpret_cast<uintptr_t>(m_current) % alignment) % alignment;
+        }
+
+        std::byte* result = m_current + padding;
+        m_current += padding + bytes;
+        m_left -= padding + bytes;
+        m_allocated_bytes += bytes;
+
+        return result;
+    }
+
+    void Arena::do_deallocate([[maybe_unused]] void* address, [[maybe_unused]] size_t bytes, [[maybe_unused]] size_t alignment) {
+        // no-op, memory is reclaimed by `release`
+    }
+
+    bool Arena::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+        return this == &other;
+    }
+
+    void Arena::add_block(size_t min_size) {
+        // blocks grow geometrically, so a decode needs a logarithmic number of them
+        size_t size = m_blocks.empty() ? m_block_size : m_blocks.back().size * 2;
+        size = std::max(size, min_size);
+
+        m_blocks.reserve(m_blocks.size() + 1);
+        auto* memory = static_cast<std::byte*>(::operator new(size));
+        m_blocks.push_back(Block{ memory, size });
+
+        m_current = memory;
+        m_left = size;
+    }
+
+    void Arena::free_blocks() noexcept {
+        for (const auto& block : m_blocks) {
+            ::operator delete(block.memory);
+        }
+        m_blocks.clear();
+        m_current = nullptr;
+        m_left = 0;
+    }
+
+} // namespace png_decoder
@@ -0,0 +1,55 @@
+#pragma once
+
+// stl includes
+#include <vector>
+#include <memory_resource>
+#include <cstddef>
+#include <cstdint>
+
+// custom includes
+
+namespace png_decoder {
+
+    // Bump allocator for short-lived per-decode memory. Deallocation is a no-op, everything is freed
+    // at once by `release`. After a release the blocks are coalesced into a single one (up to `retain_limit`
+    // bytes) which is kept, so a warm arena serves the next similar decode without touching malloc.
+    // Not thread-safe.
+    class Arena : public std::pmr::memory_resource {
+    public:
+        static constexpr size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+        static constexpr size_t DEFAULT_RETAIN_LIMIT = 64 * 1024 * 1024;
+
+        explicit Arena(size_t block_size = DEFAULT_BLOCK_SIZE, size_t retain_limit = DEFAULT_RETAIN_LIMIT);
+        ~Arena() override;
+
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        // frees all allocations in one shot, memory handed out before must not be used afterwards
+        void release() noexcept;
+
+        // bytes handed out since the last release
+        size_t get_allocated_bytes() const noexcept;
+
+    private:
+        struct Block {
+            std::byte* memory;
+            size_t size;
+        };
+
+        std::vector<Block> m_blocks;
+        size_t m_block_size;
+        size_t m_retain_limit;
+        std::byte* m_current;
+        size_t m_left;
+        size_t m_allocated_bytes;
+
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void* address, size_t bytes, size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+        void add_block(size_t min_size);
+        void free_blocks() noexcept;
+    };
+
+} // namespace png_decoder
@@ -7,27 +7,30 @@
 
 // custom includes
 #include "../utils.h"
+#include "../crc_calculator/crc_calculator.h"
 
 namespace png_decoder {
-    Chunk::Chunk(std::string type_label, std::vector <uint8_t> data, uint32_t crc) :
-        m_type_label(type_label),
-        m_data(std::move(data)),
-        m_crc(crc)
+    Chunk::Chunk(ChunkTag tag, std::span<const uint8_t> data, uint32_t crc, uint64_t position) :
+        m_tag(tag),
+        m_data(data),
+        m_crc(crc),
+        m_position(position)
     {
-        if (m_type_label == "IHDR") {
-            m_type = ChunkType::HEADER;
-        }
-        else if (m_type_label == "PLTE") {
-            m_type = ChunkType::PALETTE;
-        }
-        else if (m_type_label == "IDAT") {
-            m_type = ChunkType::DATA;
-        }
-        else if (m_type_label == "IEND") {
-            m_type = ChunkType::END;
-        }
-        else {
-            m_type = ChunkType::ANCILLARY;
+        switch (m_tag) {
+            case chunk_tag::IHDR:
+                m_type = ChunkType::HEADER;
+                break;
+            case chunk_tag::PLTE:
+                m_type = ChunkType::PALETTE;
+                break;
+            case chunk_tag::IDAT:
+                m_type = ChunkType::DATA;
+                break;
+            case chunk_tag::IEND:
+                m_type = ChunkType::END;
+                break;
+            default:
+                m_type = ChunkType::ANCILLARY;
         }
     }
 
@@ -35,8 +38,12 @@ namespace png_decoder {
         return m_type;
     }
 
+    ChunkTag Chunk::get_tag() const noexcept {
+        return m_tag;
+    }
+
     std::string Chunk::get_type_label() const {
-        return m_type_label;
+        return get_chunk_tag_label(m_tag);
     }
 
     uint32_t Chunk::get_length() const noexcept {
@@ -47,10 +54,19 @@ namespace png_decoder {
         return m_crc;
     }
 
+    uint64_t Chunk::get_position() const noexcept {
+        return m_position;
+    }
+
+    uint64_t Chunk::get_end_position() const noexcept {
+        // length, type and crc fields around the data
+        return m_position + 12 + m_data.size();
+    }
+
     std::string Chunk::to_string(bool should_print_data = false) const {
         std::stringstream ss; 
         ss << "length: " << m_data.size() << std::endl
-           << "type: " << m_type_label << std::endl
+           << "type: " << get_type_label() << std::endl
            << "crc: " << m_crc << std::endl;
         
         if (should_print_data) {
@@ -64,28 +80,17 @@ namespace png_decoder {
         return ss.str();
     }
 
-    std::vector<char> Chunk::get_crc_bytes_sequence() {
-        std::vector <char> sequence(m_type_label.size() + m_data.size());
-
-        if (!m_type_label.empty()) {
-            std::memcpy(sequence.data(), m_type_label.data(), m_type_label.size());
-        }
-        if (!m_data.empty()) {
-            std::memcpy(sequence.data() + m_type_label.size(), m_data.data(), m_data.size());
-        }
-
-        return sequence;
-    }
-
-    uint32_t Chunk::get_crc_bytes_sequence_length() const {
-        return m_data.size() + m_type_label.size();
+    uint32_t Chunk::compute_crc() const noexcept {
+        auto tag_bytes = get_chunk_tag_bytes(m_tag);
+        uint32_t crc = crc_calculator::update_crc32_checksum(0, tag_bytes.data(), tag_bytes.size());
+        return crc_calculator::update_crc32_checksum(crc, m_data.data(), m_data.size());
     }
 
-    char* Chunk::get_data_bytes() {
-        return reinterpret_cast<char*> (m_data.data());
+    const char* Chunk::get_data_bytes() const noexcept {
+        return reinterpret_cast<const char*> (m_data.data());
     }
 
-    std::vector<uint8_t>& Chunk::get_data() {
+    std::span<const uint8_t> Chunk::get_data() const noexcept {
         return m_data;
     }
 } // namespace png_decoder
\ No newline at end of file
@@ -5,8 +5,50 @@
 #include <fstream>
 #include <cstdint>
 #include <memory>
+#include <span>
+#include <array>
+#include <string>
 
 namespace png_decoder {
+    // chunk type as a 4-byte big-endian tag (FourCC), "IHDR" is 0x49484452
+    using ChunkTag = uint32_t;
+
+    constexpr ChunkTag make_chunk_tag(const char (&label)[5]) noexcept {
+        return (ChunkTag(uint8_t(label[0])) << 24) | (ChunkTag(uint8_t(label[1])) << 16)
+             | (ChunkTag(uint8_t(label[2])) << 8) | ChunkTag(uint8_t(label[3]));
+    }
+
+    // tag of the 4 type bytes as stored in the file
+    inline ChunkTag read_chunk_tag(const uint8_t* bytes) noexcept {
+        return (ChunkTag(bytes[0]) << 24) | (ChunkTag(bytes[1]) << 16) | (ChunkTag(bytes[2]) << 8) | ChunkTag(bytes[3]);
+    }
+
+    // the 4 type bytes of a tag as stored in the file
+    inline std::array<uint8_t, 4> get_chunk_tag_bytes(ChunkTag tag) noexcept {
+        return { uint8_t(tag >> 24), uint8_t(tag >> 16), uint8_t(tag >> 8), uint8_t(tag) };
+    }
+
+    // critical chunks (IHDR, PLTE, IDAT, IEND) have an uppercase first letter, ancillary ones a lowercase
+    constexpr bool is_critical_chunk(ChunkTag tag) noexcept {
+        return (tag & 0x20000000) == 0;
+    }
+
+    // the tag as text, for messages
+    inline std::string get_chunk_tag_label(ChunkTag tag) {
+        auto bytes = get_chunk_tag_bytes(tag);
+        return std::string(bytes.begin(), bytes.end());
+    }
+
+    namespace chunk_tag {
+        constexpr ChunkTag IHDR = make_chunk_tag("IHDR");
+        constexpr ChunkTag PLTE = make_chunk_tag("PLTE");
+        constexpr ChunkTag IDAT = make_chunk_tag("IDAT");
+        constexpr ChunkTag IEND = make_chunk_tag("IEND");
+        constexpr ChunkTag iDOT = make_chunk_tag("iDOT");
+        constexpr ChunkTag pHYs = make_chunk_tag("pHYs");
+        constexpr ChunkTag tEXt = make_chunk_tag("tEXt");
+    } // namespace chunk_tag
+
     // inner classes definitions
     class Chunk {
     public:
@@ -18,22 +60,31 @@ namespace png_decoder {
             ANCILLARY // helper type
         };
 
-        Chunk(std::string type_label, std::vector <uint8_t> data, uint32_t crc);
+        // the chunk only views `data`: it lives in the per-decode arena of a `DecoderContext` for stream input
+        // or in the caller's buffer (e.g. a file mapping) for memory input;
+        // `position` is the offset of the chunk length field from the start of the file
+        Chunk(ChunkTag tag, std::span<const uint8_t> data, uint32_t crc, uint64_t position = 0);
 
         ChunkType get_type() const noexcept;
+        ChunkTag get_tag() const noexcept;
+        // the tag as text, for messages
         std::string get_type_label() const;
         uint32_t get_length() const noexcept; // length is always `uint32_t`
         uint32_t get_crc() const noexcept;
+        uint64_t get_position() const noexcept;
+        // offset right past the chunk crc, where the next chunk starts
+        uint64_t get_end_position() const noexcept;
         std::string to_string(bool should_print_data) const;
-        char* get_data_bytes();
-        std::vector<char> get_crc_bytes_sequence();
-        uint32_t get_crc_bytes_sequence_length() const;
-        std::vector<uint8_t>& get_data();
+        const char* get_data_bytes() const noexcept;
+        // crc over the type label and the data, computed in place
+        uint32_t compute_crc() const noexcept;
+        std::span<const uint8_t> get_data() const noexcept;
 
     private:
-        std::string m_type_label;
+        ChunkTag m_tag;
         ChunkType m_type;
-        std::vector <uint8_t> m_data;
+        std::span<const uint8_t> m_data;
         uint32_t m_crc; // cyclic redundancy check
+        uint64_t m_position;
     };
 } // namespace png_decoder
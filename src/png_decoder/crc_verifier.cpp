@@ -0,0 +1,64 @@
+#include "crc_verifier.h"
+
+// stl includes
+#include <algorithm>
+
+// custom includes
+#include "../crc_calculator/crc_calculator.h"
+
+namespace png_decoder {
+
+    CrcVerifier::CrcVerifier(const std::pmr::vector<Chunk>& chunks, std::vector<size_t> chunk_indices, uint32_t thread_count) :
+        m_chunks(chunks),
+        m_chunk_indices(std::move(chunk_indices)),
+        m_next_piece(0)
+    {
+        for (size_t index = 0; index < m_chunk_indices.size(); ++index) {
+            uint64_t length = m_chunks[m_chunk_indices[index]].get_length();
+            for (uint64_t offset = 0; offset < length; offset += PIECE_SIZE) {
+                m_pieces.push_back(Piece{ index, offset, std::min<uint64_t>(PIECE_SIZE, length - offset) });
+            }
+        }
+        m_piece_crcs.resize(m_pieces.size());
+
+        size_t workers = std::min<size_t>(thread_count, m_pieces.size());
+        for (size_t worker = 0; worker < workers; ++worker) {
+            m_workers.push_back(std::async(std::launch::async, &CrcVerifier::run_worker, this));
+        }
+    }
+
+    std::optional<CrcVerifier::Mismatch> CrcVerifier::wait() {
+        // the caller helps with the pieces left, with no workers it does all of them
+        run_worker();
+        for (auto& worker : m_workers) {
+            worker.get();
+        }
+        m_workers.clear();
+
+        size_t piece = 0;
+        for (size_t index = 0; index < m_chunk_indices.size(); ++index) {
+            const Chunk& chunk = m_chunks[m_chunk_indices[index]];
+            auto tag_bytes = get_chunk_tag_bytes(chunk.get_tag());
+            uint32_t checksum = crc_calculator::update_crc32_checksum(0, tag_bytes.data(), tag_bytes.size());
+
+            for (; piece < m_pieces.size() && m_pieces[piece].entry == index; ++piece) {
+                checksum = crc_calculator::combine_crc32_checksums(checksum, m_piece_crcs[piece], m_pieces[piece].length);
+            }
+
+            if (checksum != chunk.get_crc()) {
+                return Mismatch{ m_chunk_indices[index], checksum };
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    void CrcVerifier::run_worker() {
+        for (size_t index = m_next_piece++; index < m_pieces.size(); index = m_next_piece++) {
+            const Piece& piece = m_pieces[index];
+            const auto& data = m_chunks[m_chunk_indices[piece.entry]].get_data();
+            m_piece_crcs[index] = crc_calculator::update_crc32_checksum(0, data.data() + piece.offset, piece.length);
+        }
+    }
+
+} // namespace png_decoder
@@ -0,0 +1,57 @@
+#pragma once
+
+// stl includes
+#include <vector>
+#include <optional>
+#include <future>
+#include <atomic>
+#include <memory_resource>
+#include <cstdint>
+
+// custom includes
+#include "chunk.h"
+
+namespace png_decoder {
+
+    // Verifies chunk crcs on worker threads while the caller does other work (inflates the image data).
+    // Chunks are split into pieces of at most `PIECE_SIZE` bytes whose crcs are joined afterwards,
+    // so a single huge IDAT is spread over all workers.
+    class CrcVerifier {
+    public:
+        struct Mismatch {
+            // index into the chunks handed to the constructor
+            size_t chunk_index;
+            uint32_t checksum;
+        };
+
+        static constexpr size_t PIECE_SIZE = 1024 * 1024;
+
+        // starts `thread_count` workers over the chunks at `chunk_indices` of `chunks`, with no workers everything
+        // is verified by `wait`; the chunks must not change until `wait` returns
+        CrcVerifier(const std::pmr::vector<Chunk>& chunks, std::vector<size_t> chunk_indices, uint32_t thread_count);
+        CrcVerifier(const CrcVerifier&) = delete;
+        CrcVerifier& operator=(const CrcVerifier&) = delete;
+
+        // waits for the workers and reports the first chunk of `chunk_indices` with a wrong crc, whatever the scheduling
+        std::optional<Mismatch> wait();
+
+    private:
+        struct Piece {
+            // the piece is part of chunk `m_chunk_indices[entry]`
+            size_t entry;
+            uint64_t offset;
+            uint64_t length;
+        };
+
+        const std::pmr::vector<Chunk>& m_chunks;
+        std::vector<size_t> m_chunk_indices;
+        std::vector<Piece> m_pieces;
+        std::vector<uint32_t> m_piece_crcs;
+        std::atomic<size_t> m_next_piece;
+        // declared last, so the destructor joins the workers before the state they use goes away
+        std::vector<std::future<void>> m_workers;
+
+        void run_worker();
+    };
+
+} // namespace png_decoder
@@ -0,0 +1,62 @@
+#include "decoder_context.h"
+
+// stl includes
+#include <vector>
+#include <memory>
+#include <utility>
+
+// custom includes
+
+namespace png_decoder {
+
+    DecoderContext::DecoderContext() :
+        m_stream_inflater(&m_stream_inflate_arena),
+        m_chunks(&m_arena),
+        m_image_data(&m_arena) {}
+
+    void DecoderContext::begin_decode() {
+        m_chunks.clear();
+        m_image_data.clear();
+    }
+
+    void DecoderContext::end_decode() noexcept {
+        // swapping with empty containers frees their storage, the arena has equal allocators on both sides
+        std::pmr::vector<Chunk>(&m_arena).swap(m_chunks);
+        std::pmr::vector<uint8_t>(&m_arena).swap(m_image_data);
+
+        m_arena.release();
+    }
+
+    inflater::Inflater& DecoderContext::get_inflater(inflater::Backend backend) {
+        if (!m_inflater || m_inflater->get_backend() != backend) {
+            m_inflater.reset();
+            m_inflate_arena.release();
+            m_inflater = std::make_unique<inflater::Inflater>(backend, &m_inflate_arena);
+        }
+        return *m_inflater;
+    }
+
+    std::vector<std::unique_ptr<inflater::SegmentInflater>>& DecoderContext::get_segment_inflaters(size_t count) {
+        while (m_segment_inflaters.size() < count) {
+            m_segment_inflaters.push_back(std::make_unique<inflater::SegmentInflater>());
+        }
+        return m_segment_inflaters;
+    }
+
+    inflater::StreamInflater& DecoderContext::get_stream_inflater() noexcept {
+        return m_stream_inflater;
+    }
+
+    std::pmr::memory_resource* DecoderContext::get_memory_resource() noexcept {
+        return &m_arena;
+    }
+
+    std::pmr::vector<Chunk>& DecoderContext::get_chunks() noexcept {
+        return m_chunks;
+    }
+
+    std::pmr::vector<uint8_t>& DecoderContext::get_image_data() noexcept {
+        return m_image_data;
+    }
+
+} // namespace png_decoder
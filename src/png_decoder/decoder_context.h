@@ -0,0 +1,63 @@
+#pragma once
+
+// stl includes
+#include <vector>
+#include <memory>
+#include <memory_resource>
+#include <cstdint>
+
+// custom includes
+#include "arena.h"
+#include "chunk.h"
+#include "../inflater/inflater.h"
+#include "../inflater/segment_inflater.h"
+#include "../inflater/stream_inflater.h"
+
+namespace png_decoder {
+
+    // State reused between decodes: a live inflater (zlib keeps its state and window allocated and is only reset)
+    // and an arena backing all per-decode buffers (chunk data, inflated data, scanlines), which is freed in one shot
+    // when a decode finishes and keeps its memory for the next one. One warm context per thread can decode image
+    // after image without touching the global allocator; a context must not be used by two decoders at the same time.
+    class DecoderContext {
+    public:
+        DecoderContext();
+
+        DecoderContext(const DecoderContext&) = delete;
+        DecoderContext& operator=(const DecoderContext&) = delete;
+
+        // clears the buffers of the previous image
+        void begin_decode();
+        // drops all per-decode buffers and releases the arena, memory taken from `get_memory_resource` becomes invalid
+        void end_decode() noexcept;
+
+        // inflater for `backend`, it is created on first use and replaced only when the backend changes;
+        // its internal zlib state is allocated from a separate arena living as long as the inflater
+        inflater::Inflater& get_inflater(inflater::Backend backend);
+
+        // at least `count` segment inflaters, one per worker thread; they allocate with malloc as they run concurrently
+        std::vector<std::unique_ptr<inflater::SegmentInflater>>& get_segment_inflaters(size_t count);
+
+        // inflater handing out the image data scanline by scanline, see `DecoderOptions::fused_rows`; its zlib state
+        // is allocated from an arena of its own, which lives as long as the context
+        inflater::StreamInflater& get_stream_inflater() noexcept;
+
+        // allocator for buffers which live until `end_decode`
+        std::pmr::memory_resource* get_memory_resource() noexcept;
+
+        std::pmr::vector<Chunk>& get_chunks() noexcept;
+        std::pmr::vector<uint8_t>& get_image_data() noexcept;
+
+    private:
+        // arenas are declared first, so they outlive everything allocated from them
+        Arena m_inflate_arena;
+        Arena m_stream_inflate_arena;
+        Arena m_arena;
+        std::unique_ptr<inflater::Inflater> m_inflater;
+        std::vector<std::unique_ptr<inflater::SegmentInflater>> m_segment_inflaters;
+        inflater::StreamInflater m_stream_inflater;
+        std::pmr::vector<Chunk> m_chunks;
+        std::pmr::vector<uint8_t> m_image_data;
+    };
+
+} // namespace png_decoder
@@ -0,0 +1,68 @@
+#pragma once
+
+// stl includes
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <optional>
+
+// custom includes
+#include "../inflater/inflate_backend.h"
+#include "chunk.h"
+
+namespace png_decoder {
+
+    // bounds for untrusted input, exceeding one throws `error::limit_exceeded`. Image dimensions are checked as soon
+    // as IHDR is read, before the rest of the file; chunk lengths before their data is allocated
+    struct DecodeLimits {
+        uint32_t max_width = 1u << 24;
+        uint32_t max_height = 1u << 24;
+        uint64_t max_pixels = 1ull << 28;
+        // the spec allows chunks of up to 2^31 - 1 bytes
+        uint32_t max_chunk_size = 0x7fffffff;
+        // filtered scanlines of all passes, the inflate stops as soon as the data outgrows the size derived from IHDR
+        uint64_t max_inflated_size = 4ull << 30;
+        // chunk data copied from a stream, inflated data, scanlines (with the zlib state of the fused rows), the
+        // ranges of the speculative inflate and the final image together; chunks decoded in place from memory are
+        // owned by the caller and not counted. The speculative inflate falls back to a serial one when its ranges
+        // do not fit
+        uint64_t max_memory = 8ull << 30;
+    };
+
+    struct DecoderOptions {
+        // engine used to inflate IDAT data, must be enabled at build time; images taken by `speculative_inflate`
+        // or `fused_rows` are inflated by their own decoders instead
+        inflater::Backend inflate_backend = inflater::default_backend();
+        // inflate and defilter independently compressed segments (Apple iDOT) on separate threads,
+        // images without segment markers always take the serial path
+        bool parallel_inflate = true;
+        // experimental: inflate a single-stream image speculatively on several threads,
+        // once its compressed data is at least `speculative_inflate_threshold` bytes. The speculative decoder
+        // overrides `inflate_backend` for those images, smaller ones still use the backend
+        bool speculative_inflate = false;
+        size_t speculative_inflate_threshold = 16 * 1024 * 1024;
+        // inflate, defilter and convert one scanline at a time instead of a pass over the whole image each: the working
+        // set stays at two rows plus the zlib window. The data is inflated with zlib whatever `inflate_backend` is,
+        // iDOT segments and the speculative inflate are not used
+        bool fused_rows = false;
+        // opt-in: the fused rows run as a pipeline on separate threads, inflate (the calling thread), defilter and pixel
+        // conversion on up to `thread_count - 2` workers, connected by bounded lock-free queues of row batches.
+        // Chunks are read and their crcs started (see `parallel_crc`) before it runs. With fewer than 3 threads
+        // allowed the fused rows are decoded on the calling thread instead
+        bool pipelined_rows = false;
+        // check the crc of every chunk, a mismatch throws `error::invalid_crc_checksum`
+        bool verify_crc = true;
+        // verify IDAT crcs on worker threads while the image data is being inflated,
+        // once the image data is at least `parallel_crc_threshold` bytes
+        bool parallel_crc = true;
+        size_t parallel_crc_threshold = 256 * 1024;
+        // ancillary chunks kept in memory during the decode, unset keeps all of them; other chunks are never stored:
+        // with `verify_crc` their crc is computed through a small buffer, otherwise they are skipped with a seek.
+        // Critical chunks are always kept, so is iDOT with `parallel_inflate`
+        std::optional<std::vector<ChunkTag>> retained_chunks;
+        DecodeLimits limits;
+        // upper bound of worker threads, 0 means the number of hardware threads
+        uint32_t thread_count = 0;
+    };
+
+} // namespace png_decoder
@@ -0,0 +1,520 @@
+#include "defilter_kernels.h"
+
+// stl includes
+#include <array>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define PNG_DECODER_DEFILTER_X86
+#endif
+
+// custom includes
+
+
+
+namespace png_decoder::defilter_kernels {
+
+    namespace {
+        constexpr uint32_t MAX_BPP = 8;
+        // kernel tables of one implementation indexed by bpp, the ones of 0, 5 and 7 bytes per pixel are empty
+        using BppKernelTables = std::array<KernelTable, MAX_BPP + 1>;
+
+        // scalar kernels, the first pixel has no left neighbour and predicts from zeros
+
+        void none([[maybe_unused]] uint8_t* row, [[maybe_unused]] const uint8_t* prior, [[maybe_unused]] size_t length) {
+            // no-op
+        }
+
+        template <uint32_t BPP>
+        void sub_scalar(uint8_t* row, [[maybe_unused]] const uint8_t* prior, size_t length) {
+            for (size_t i = BPP; i < length; ++i) {
+                row[i] += row[i - BPP];
+            }
+        }
+
+        void up_scalar(uint8_t* row, const uint8_t* prior, size_t length) {
+            for (size_t i = 0; i < length; ++i) {
+                row[i] += prior[i];
+            }
+        }
+
+        template <uint32_t BPP>
+        void average_scalar(uint8_t* row, const uint8_t* prior, size_t length) {
+            size_t i = 0;
+            for (; i < BPP && i < length; ++i) {
+                row[i] += prior[i] >> 1;
+            }
+            for (; i < length; ++i) {
+                row[i] += (row[i - BPP] + prior[i]) >> 1;
+            }
+        }
+
+        inline uint8_t paeth_predictor(int32_t left, int32_t above, int32_t upper_left) {
+            // distances of left + above - upper_left to each neighbour, ties go to left, then above
+            int32_t pa = std::abs(above - upper_left);
+            int32_t pb = std::abs(left - upper_left);
+            int32_t pc = std::abs(left + above - 2 * upper_left);
+
+            if (pa <= pb && pa <= pc) {
+                return static_cast<uint8_t>(left);
+            }
+            return static_cast<uint8_t>(pb <= pc ? above : upper_left);
+        }
+
+        template <uint32_t BPP>
+        void paeth_scalar(uint8_t* row, const uint8_t* prior, size_t length) {
+            size_t i = 0;
+            // only `above` is known for the first pixel, which it is closest to
+            for (; i < BPP && i < length; ++i) {
+                row[i] += prior[i];
+            }
+            for (; i < length; ++i) {
+                row[i] += paeth_predictor(row[i - BPP], prior[i], prior[i - BPP]);
+            }
+        }
+
+        template <uint32_t BPP>
+        constexpr KernelTable scalar_kernels() {
+            return { none, sub_scalar<BPP>, up_scalar, average_scalar<BPP>, paeth_scalar<BPP> };
+        }
+
+#ifdef PNG_DECODER_DEFILTER_X86
+        // Sub, average and paeth depend on the defiltered left pixel, so they go pixel by pixel with all channels
+        // of a pixel in one register; up and sub with power of two bpp work on whole registers.
+        // SSE2 is part of x86-64, only the wider extensions need target attributes.
+
+        // 3 and 6 byte pixels are read with 4 and 8 byte loads while the row is long enough, the extra lanes are
+        // never stored; a store covering the next load would stall the store forwarding
+        template <uint32_t BPP>
+        inline __m128i load_pixel(const uint8_t* bytes, bool is_wide) noexcept {
+            if constexpr (BPP <= 4) {
+                uint32_t value = 0;
+                // separate copies of constant size, a variable one is a library call
+                if (is_wide) {
+                    std::memcpy(&value, bytes, sizeof(value));
+                }
+                else {
+                    std::memcpy(&value, bytes, BPP);
+                }
+                return _mm_cvtsi32_si128(static_cast<int32_t>(value));
+            }
+            else {
+                uint64_t value = 0;
+                if (is_wide) {
+                    std::memcpy(&value, bytes, sizeof(value));
+                }
+                else {
+                    std::memcpy(&value, bytes, BPP);
+                }
+                return _mm_cvtsi64_si128(static_cast<int64_t>(value));
+            }
+        }
+
+        template <uint32_t BPP>
+        inline void store_pixel(uint8_t* bytes, __m128i pixel) noexcept {
+            if constexpr (BPP <= 4) {
+                uint32_t value = static_cast<uint32_t>(_mm_cvtsi128_si32(pixel));
+                std::memcpy(bytes, &value, BPP);
+            }
+            else {
+                uint64_t value = static_cast<uint64_t>(_mm_cvtsi128_si64(pixel));
+                std::memcpy(bytes, &value, BPP);
+            }
+        }
+
+        // whether the pixel at `position` can be read with a wide load
+        template <uint32_t BPP>
+        inline bool is_wide_pixel(size_t position, size_t length) noexcept {
+            constexpr size_t WIDTH = BPP <= 4 ? 4 : 8;
+            return position + WIDTH <= length;
+        }
+
+        // copies the last pixel of `x` into every pixel position
+        template <uint32_t BPP>
+        inline __m128i broadcast_last_pixel(__m128i x) noexcept {
+            if constexpr (BPP == 1) {
+                x = _mm_unpackhi_epi8(x, x);
+                x = _mm_shufflehi_epi16(x, 0xff);
+                return _mm_shuffle_epi32(x, 0xff);
+            }
+            else if constexpr (BPP == 2) {
+                return _mm_shuffle_epi32(_mm_shufflehi_epi16(x, 0xff), 0xff);
+            }
+            else if constexpr (BPP == 4) {
+                return _mm_shuffle_epi32(x, 0xff);
+            }
+            else {
+                return _mm_unpackhi_epi64(x, x);
+            }
+        }
+
+        // running sum of the pixels of a register: log2(16 / BPP) shifted adds
+        template <uint32_t BPP>
+        inline __m128i prefix_sum(__m128i x) noexcept {
+            x = _mm_add_epi8(x, _mm_slli_si128(x, BPP));
+            if constexpr (BPP <= 4) {
+                x = _mm_add_epi8(x, _mm_slli_si128(x, 2 * BPP));
+            }
+            if constexpr (BPP <= 2) {
+                x = _mm_add_epi8(x, _mm_slli_si128(x, 4 * BPP));
+            }
+            if constexpr (BPP == 1) {
+                x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+            }
+            return x;
+        }
+
+        template <uint32_t BPP>
+        void sub_sse2(uint8_t* row, [[maybe_unused]] const uint8_t* prior, size_t length) {
+            if constexpr (BPP == 3 || BPP == 6) {
+                __m128i left = _mm_setzero_si128();
+                for (size_t i = 0; i < length; i += BPP) {
+                    bool is_wide = is_wide_pixel<BPP>(i, length);
+                    left = _mm_add_epi8(load_pixel<BPP>(row + i, is_wide), left);
+                    store_pixel<BPP>(row + i, left);
+                }
+            }
+            else {
+                __m128i carry = _mm_setzero_si128();
+                size_t i = 0;
+                for (; i + 16 <= length; i += 16) {
+                    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+                    x = _mm_add_epi8(prefix_sum<BPP>(x), carry);
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(row + i), x);
+                    carry = broadcast_last_pixel<BPP>(x);
+                }
+                for (i = std::max<size_t>(i, BPP); i < length; ++i) {
+                    row[i] += row[i - BPP];
+                }
+            }
+        }
+
+        void up_sse2(uint8_t* row, const uint8_t* prior, size_t length) {
+            size_t i = 0;
+            for (; i + 16 <= length; i += 16) {
+                __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+                __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prior + i));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(row + i), _mm_add_epi8(x, b));
+            }
+            for (; i < length; ++i) {
+                row[i] += prior[i];
+            }
+        }
+
+        template <uint32_t BPP>
+        void average_sse2(uint8_t* row, const uint8_t* prior, size_t length) {
+            const __m128i one = _mm_set1_epi8(1);
+            __m128i left = _mm_setzero_si128();
+            for (size_t i = 0; i < length; i += BPP) {
+                bool is_wide = is_wide_pixel<BPP>(i, length);
+                __m128i above = load_pixel<BPP>(prior + i, is_wide);
+                // pavgb rounds up, the filter rounds down
+                __m128i average = _mm_sub_epi8(_mm_avg_epu8(left, above), _mm_and_si128(_mm_xor_si128(left, above), one));
+                left = _mm_add_epi8(load_pixel<BPP>(row + i, is_wide), average);
+                store_pixel<BPP>(row + i, left);
+            }
+        }
+
+        // predictor of up to 8 channels held in 16-bit lanes, from the distances of left + above - upper_left
+        // to each neighbour: pa = |above - upper_left|, pb = |left - upper_left|, pc = |pa + pb| before abs
+        inline __m128i paeth_select(__m128i pa, __m128i pb, __m128i pc, __m128i left, __m128i above, __m128i upper_left) noexcept {
+            // left unless pa > pb or pa > pc, then above unless pb > pc
+            __m128i not_left = _mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc));
+            __m128i is_upper_left = _mm_cmpgt_epi16(pb, pc);
+            __m128i other = _mm_or_si128(_mm_andnot_si128(is_upper_left, above), _mm_and_si128(is_upper_left, upper_left));
+            return _mm_or_si128(_mm_andnot_si128(not_left, left), _mm_and_si128(not_left, other));
+        }
+
+        inline __m128i abs_epi16(__m128i x) noexcept {
+            return _mm_max_epi16(x, _mm_sub_epi16(_mm_setzero_si128(), x));
+        }
+
+        template <uint32_t BPP>
+        void paeth_sse2(uint8_t* row, const uint8_t* prior, size_t length) {
+            const __m128i zero = _mm_setzero_si128();
+            __m128i left = zero;
+            __m128i upper_left = zero;
+            for (size_t i = 0; i < length; i += BPP) {
+                bool is_wide = is_wide_pixel<BPP>(i, length);
+                __m128i above = _mm_unpacklo_epi8(load_pixel<BPP>(prior + i, is_wide), zero);
+                __m128i above_distance = _mm_sub_epi16(above, upper_left);
+                __m128i left_distance = _mm_sub_epi16(left, upper_left);
+                __m128i predictor = paeth_select(
+                    abs_epi16(above_distance),
+                    abs_epi16(left_distance),
+                    abs_epi16(_mm_add_epi16(above_distance, left_distance)),
+                    left, above, upper_left
+                );
+                __m128i x = _mm_add_epi8(load_pixel<BPP>(row + i, is_wide), _mm_packus_epi16(predictor, predictor));
+                store_pixel<BPP>(row + i, x);
+                left = _mm_unpacklo_epi8(x, zero);
+                upper_left = above;
+            }
+        }
+
+        // the same as `paeth_sse2` with pabsw
+        template <uint32_t BPP>
+        __attribute__((target("ssse3")))
+        void paeth_ssse3(uint8_t* row, const uint8_t* prior, size_t length) {
+            const __m128i zero = _mm_setzero_si128();
+            __m128i left = zero;
+            __m128i upper_left = zero;
+            for (size_t i = 0; i < length; i += BPP) {
+                bool is_wide = is_wide_pixel<BPP>(i, length);
+                __m128i above = _mm_unpacklo_epi8(load_pixel<BPP>(prior + i, is_wide), zero);
+                __m128i above_distance = _mm_sub_epi16(above, upper_left);
+                __m128i left_distance = _mm_sub_epi16(left, upper_left);
+                __m128i predictor = paeth_select(
+                    _mm_abs_epi16(above_distance),
+                    _mm_abs_epi16(left_distance),
+                    _mm_abs_epi16(_mm_add_epi16(above_distance, left_distance)),
+                    left, above, upper_left
+                );
+                __m128i x = _mm_add_epi8(load_pixel<BPP>(row + i, is_wide), _mm_packus_epi16(predictor, predictor));
+                store_pixel<BPP>(row + i, x);
+                left = _mm_unpacklo_epi8(x, zero);
+                upper_left = above;
+            }
+        }
+
+        template <uint32_t BPP>
+        __attribute__((target("avx2")))
+        inline __m256i broadcast_last_pixel_avx2(__m256i x) noexcept {
+            // the same shuffles as `broadcast_last_pixel`, applied to each 128-bit lane
+            if constexpr (BPP == 1) {
+                x = _mm256_unpackhi_epi8(x, x);
+                x = _mm256_shufflehi_epi16(x, 0xff);
+                return _mm256_shuffle_epi32(x, 0xff);
+            }
+            else if constexpr (BPP == 2) {
+                return _mm256_shuffle_epi32(_mm256_shufflehi_epi16(x, 0xff), 0xff);
+            }
+            else if constexpr (BPP == 4) {
+                return _mm256_shuffle_epi32(x, 0xff);
+            }
+            else {
+                return _mm256_unpackhi_epi64(x, x);
+            }
+        }
+
+        template <uint32_t BPP>
+        __attribute__((target("avx2")))
+        void sub_avx2(uint8_t* row, const uint8_t* prior, size_t length) {
+            if constexpr (BPP == 3 || BPP == 6) {
+                sub_sse2<BPP>(row, prior, length);
+            }
+            else {
+                __m256i carry = _mm256_setzero_si256();
+                size_t i = 0;
+                for (; i + 32 <= length; i += 32) {
+                    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i));
+                    // running sums within each lane, then the low lane total is carried into the high lane
+                    x = _mm256_add_epi8(x, _mm256_slli_si256(x, BPP));
+                    if constexpr (BPP <= 4) {
+                        x = _mm256_add_epi8(x, _mm256_slli_si256(x, 2 * BPP));
+                    }
+                    if constexpr (BPP <= 2) {
+                        x = _mm256_add_epi8(x, _mm256_slli_si256(x, 4 * BPP));
+                    }
+                    if constexpr (BPP == 1) {
+                        x = _mm256_add_epi8(x, _mm256_slli_si256(x, 8));
+                    }
+                    __m256i lane_totals = broadcast_last_pixel_avx2<BPP>(x);
+                    x = _mm256_add_epi8(x, _mm256_permute2x128_si256(lane_totals, lane_totals, 0x08));
+                    x = _mm256_add_epi8(x, carry);
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(row + i), x);
+
+                    __m256i totals = broadcast_last_pixel_avx2<BPP>(x);
+                    carry = _mm256_permute2x128_si256(totals, totals, 0x11);
+                }
+                for (i = std::max<size_t>(i, BPP); i < length; ++i) {
+                    row[i] += row[i - BPP];
+                }
+            }
+        }
+
+        __attribute__((target("avx2")))
+        void up_avx2(uint8_t* row, const uint8_t* prior, size_t length) {
+            size_t i = 0;
+            for (; i + 32 <= length; i += 32) {
+                __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + i));
+                __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prior + i));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(row + i), _mm256_add_epi8(x, b));
+            }
+            for (; i < length; ++i) {
+                row[i] += prior[i];
+            }
+        }
+
+        // average and paeth of 1 and 2 byte pixels gain nothing from a register per pixel, the scalar loops stay
+
+        template <uint32_t BPP>
+        constexpr KernelTable sse2_kernels() {
+            if constexpr (BPP <= 2) {
+                return { none, sub_sse2<BPP>, up_sse2, average_scalar<BPP>, paeth_scalar<BPP> };
+            }
+            else {
+                return { none, sub_sse2<BPP>, up_sse2, average_sse2<BPP>, paeth_sse2<BPP> };
+            }
+        }
+
+        template <uint32_t BPP>
+        constexpr KernelTable ssse3_kernels() {
+            KernelTable kernels = sse2_kernels<BPP>();
+            if constexpr (BPP > 2) {
+                kernels[4] = paeth_ssse3<BPP>;
+            }
+            return kernels;
+        }
+
+        template <uint32_t BPP>
+        constexpr KernelTable avx2_kernels() {
+            KernelTable kernels = ssse3_kernels<BPP>();
+            kernels[1] = sub_avx2<BPP>;
+            kernels[2] = up_avx2;
+            return kernels;
+        }
+
+        bool has_cpu_feature(Implementation implementation) noexcept {
+            __builtin_cpu_init();
+            switch (implementation) {
+                case Implementation::SSE2:
+                    return __builtin_cpu_supports("sse2");
+                case Implementation::SSSE3:
+                    return __builtin_cpu_supports("ssse3");
+                case Implementation::AVX2:
+                    return __builtin_cpu_supports("avx2");
+                default:
+                    return false;
+            }
+        }
+#endif
+
+        template <Implementation IMPLEMENTATION, uint32_t BPP>
+        constexpr KernelTable make_kernels() {
+#ifdef PNG_DECODER_DEFILTER_X86
+            if constexpr (IMPLEMENTATION == Implementation::SSE2) {
+                return sse2_kernels<BPP>();
+            }
+            else if constexpr (IMPLEMENTATION == Implementation::SSSE3) {
+                return ssse3_kernels<BPP>();
+            }
+            else if constexpr (IMPLEMENTATION == Implementation::AVX2) {
+                return avx2_kernels<BPP>();
+            }
+            else {
+                return scalar_kernels<BPP>();
+            }
+#else
+            // never selected, the implementation is not available
+            return scalar_kernels<BPP>();
+#endif
+        }
+
+        template <Implementation IMPLEMENTATION>
+        constexpr BppKernelTables make_bpp_kernel_tables() {
+            return {
+                KernelTable{},
+                make_kernels<IMPLEMENTATION, 1>(),
+                make_kernels<IMPLEMENTATION, 2>(),
+                make_kernels<IMPLEMENTATION, 3>(),
+                make_kernels<IMPLEMENTATION, 4>(),
+                KernelTable{},
+                make_kernels<IMPLEMENTATION, 6>(),
+                KernelTable{},
+                make_kernels<IMPLEMENTATION, 8>()
+            };
+        }
+
+        // indexed by implementation, bpp and filter type
+        constexpr std::array<BppKernelTables, 4> KERNELS = {
+            make_bpp_kernel_tables<Implementation::SCALAR>(),
+            make_bpp_kernel_tables<Implementation::SSE2>(),
+            make_bpp_kernel_tables<Implementation::SSSE3>(),
+            make_bpp_kernel_tables<Implementation::AVX2>()
+        };
+
+        constexpr KernelTable EMPTY_KERNELS = {};
+
+        constexpr std::array<Implementation, 4> IMPLEMENTATIONS = {
+            Implementation::SCALAR, Implementation::SSE2, Implementation::SSSE3, Implementation::AVX2
+        };
+    }
+
+    Implementation default_implementation() noexcept {
+        static const Implementation implementation = [] {
+            Implementation best = Implementation::SCALAR;
+            for (auto implementation : IMPLEMENTATIONS) {
+                if (is_implementation_available(implementation)) {
+                    best = implementation;
+                }
+            }
+            return best;
+        }();
+        return implementation;
+    }
+
+    bool is_implementation_available(Implementation implementation) noexcept {
+        switch (implementation) {
+            case Implementation::SCALAR:
+                return true;
+            case Implementation::SSE2:
+            case Implementation::SSSE3:
+            case Implementation::AVX2:
+#ifdef PNG_DECODER_DEFILTER_X86
+                return has_cpu_feature(implementation);
+#else
+                return false;
+#endif
+        }
+        return false;
+    }
+
+    std::vector<Implementation> available_implementations() {
+        std::vector<Implementation> implementations;
+        for (auto implementation : IMPLEMENTATIONS) {
+            if (is_implementation_available(implementation)) {
+                implementations.push_back(implementation);
+            }
+        }
+        return implementations;
+    }
+
+    std::string to_string(Implementation implementation) {
+        switch (implementation) {
+            case Implementation::SCALAR:
+                return "scalar";
+            case Implementation::SSE2:
+                return "sse2";
+            case Implementation::SSSE3:
+                return "ssse3";
+            case Implementation::AVX2:
+                return "avx2";
+        }
+        return "unknown";
+    }
+
+    const KernelTable& get_kernels(Implementation implementation, uint32_t bpp) noexcept {
+        if (bpp > MAX_BPP) {
+            return EMPTY_KERNELS;
+        }
+        return KERNELS[static_cast<size_t>(implementation)][bpp];
+    }
+
+    const KernelTable& get_kernels(uint32_t bpp) noexcept {
+        static const Implementation implementation = default_implementation();
+        return get_kernels(implementation, bpp);
+    }
+
+    Kernel get_kernel(Implementation implementation, uint8_t filter_type, uint32_t bpp) noexcept {
+        return filter_type < FILTER_TYPE_COUNT ? get_kernels(implementation, bpp)[filter_type] : nullptr;
+    }
+
+    Kernel get_kernel(uint8_t filter_type, uint32_t bpp) noexcept {
+        return filter_type < FILTER_TYPE_COUNT ? get_kernels(bpp)[filter_type] : nullptr;
+    }
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+// stl includes
+#include <array>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// custom includes
+
+
+
+namespace png_decoder::defilter_kernels {
+
+    enum class Implementation : uint8_t {
+        SCALAR = 0, // portable reference
+        SSE2 = 1,
+        SSSE3 = 2,
+        AVX2 = 3
+    };
+
+    // fastest implementation supported by the running CPU, picked once on first use
+    Implementation default_implementation() noexcept;
+    bool is_implementation_available(Implementation implementation) noexcept;
+    std::vector<Implementation> available_implementations();
+    std::string to_string(Implementation implementation);
+
+    // reverses the filter of `length` bytes of `row` in place; `prior` is the defiltered previous row
+    // of the same length, zeros for the first row of an image
+    using Kernel = void (*)(uint8_t* row, const uint8_t* prior, size_t length);
+
+    // filter types 0 - 4
+    constexpr size_t FILTER_TYPE_COUNT = 5;
+    // kernels indexed by filter type
+    using KernelTable = std::array<Kernel, FILTER_TYPE_COUNT>;
+
+    // kernels for `bpp` bytes per pixel (1, 2, 3, 4, 6 or 8) from a constant table, all null for other values;
+    // look the table up once per image, the rows are dispatched by indexing it with their filter type
+    const KernelTable& get_kernels(Implementation implementation, uint32_t bpp) noexcept;
+    const KernelTable& get_kernels(uint32_t bpp) noexcept;
+
+    // kernel for a filter type (0 - none, 1 - sub, 2 - up, 3 - average, 4 - paeth) and bytes per pixel
+    // (1, 2, 3, 4, 6 or 8), null for other values; `implementation` must be available
+    Kernel get_kernel(Implementation implementation, uint8_t filter_type, uint32_t bpp) noexcept;
+    Kernel get_kernel(uint8_t filter_type, uint32_t bpp) noexcept;
+
+}
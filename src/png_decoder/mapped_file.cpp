@@ -0,0 +1,57 @@
+#include "mapped_file.h"
+
+// stl includes
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// custom includes
+#include "../errors.h"
+
+namespace png_decoder {
+
+    MappedFile::MappedFile(std::string_view filename) :
+        m_address(nullptr),
+        m_size(0)
+    {
+        std::string path(filename);
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw ::error::unable_to_open_file(path);
+        }
+
+        struct stat file_stat;
+        if (::fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode)) {
+            ::close(fd);
+            throw ::error::unable_to_open_file(path);
+        }
+        m_size = static_cast<size_t>(file_stat.st_size);
+
+        // an empty file cannot be mapped, it is an empty view
+        if (m_size != 0) {
+            m_address = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        ::close(fd);
+
+        if (m_address == MAP_FAILED) {
+            m_address = nullptr;
+            throw ::error::unable_to_open_file(path);
+        }
+        if (m_address != nullptr) {
+            // chunks are parsed front to back, let the kernel read ahead aggressively
+            ::madvise(m_address, m_size, MADV_SEQUENTIAL);
+        }
+    }
+
+    MappedFile::~MappedFile() {
+        if (m_address != nullptr) {
+            ::munmap(m_address, m_size);
+        }
+    }
+
+    std::span<const uint8_t> MappedFile::get_data() const noexcept {
+        return { static_cast<const uint8_t*>(m_address), m_size };
+    }
+
+} // namespace png_decoder
@@ -0,0 +1,30 @@
+#pragma once
+
+// stl includes
+#include <string>
+#include <string_view>
+#include <span>
+#include <cstdint>
+
+// custom includes
+
+namespace png_decoder {
+
+    // read-only memory mapping of a whole file, the pages are read from the page cache on first access
+    class MappedFile {
+    public:
+        // throws `::error::unable_to_open_file` when the file cannot be opened or mapped
+        explicit MappedFile(std::string_view filename);
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        std::span<const uint8_t> get_data() const noexcept;
+
+    private:
+        void* m_address;
+        size_t m_size;
+    };
+
+} // namespace png_decoder
@@ -2,429 +2,239 @@
 
 // stl includes
 #include <cstdint>
+#include <cstring>
 #include <memory>
-#include <vector>
-#include <optional>
+#include <string>
+#include <type_traits>
 
 // custom includes
 #include "../errors.h"
 #include "../../image.h"
-#include "../utils.h"
-#include "bit_reader.h"
 #include "pallete.h"
 
 
 namespace png_decoder {
 
-    PixelReader::PixelReader(uint8_t bit_depth, Pallete& pallete):
-        m_bit_depth(bit_depth),
-        m_pallete(pallete) {}
-    
-    std::unique_ptr<PixelReader> PixelReader::create_pixel_reader(PixelType pixel_type, uint8_t bit_depth, Pallete& pallete) {
-        switch (pixel_type) {
-            case PixelType::RGB: {
-                // std::cout << "PixelReader type is RGB" << std::endl;
-                return std::make_unique<RGBPixelReader> (bit_depth, pallete);
-            }
-            case PixelType::RGB_WITH_ALPHA: {
-                // std::cout << "PixelReader type is RGB_WITH_ALPHA" << std::endl;
-                return std::make_unique<RGBWithAlphaPixelReader> (bit_depth, pallete);
-            }
-            case PixelType::GREYSCALE: {
-                // std::cout << "PixelReader type is GREYSCALE" << std::endl;
-                return std::make_unique<GreyScalePixelReader> (bit_depth, pallete);
-            }
-            case PixelType::GRAYSCALE_WITH_ALPHA: {
-                // std::cout << "PixelReader type is GRAYSCALE_WITH_ALPHA" << std::endl;
-                return std::make_unique<GreyScaleWithAlphaPixelReader> (bit_depth, pallete);
+    namespace {
+
+        // the sample as stored: 8-bit samples as they are, 16-bit samples big endian
+        template <uint8_t BIT_DEPTH>
+        uint16_t sample_at(const uint8_t* src, size_t index) {
+            if constexpr (BIT_DEPTH == 16) {
+                return static_cast<uint16_t>((src[2 * index] << 8) | src[2 * index + 1]);
             }
-            case PixelType::PALLETE: {
-                // std::cout << "PixelReader type is PALLETE" << std::endl;
-                return std::make_unique<PalletePixelReader> (bit_depth, pallete);
+            else {
+                return src[index];
             }
         }
-    }
-
-    // RGB
-    RGBPixelReader::RGBPixelReader(uint8_t bit_depth, Pallete& pallete): PixelReader(bit_depth, pallete) {}
 
-    std::optional<RGB> RGBPixelReader::get_pixel_at(std::vector<uint8_t>& data, size_t index, size_t bits_per_pixel) {
-        size_t position = index * (bits_per_pixel / 8);
-        
-        if (position >= data.size()) {
-            return std::nullopt;
+        // `BIT_DEPTH` = 1, 2 or 4: the `index`-th sample packed from the most significant bit on
+        template <uint8_t BIT_DEPTH>
+        uint8_t packed_sample_at(const uint8_t* src, size_t index) {
+            constexpr uint8_t MASK = (1 << BIT_DEPTH) - 1;
+            constexpr size_t SAMPLES_PER_BYTE = 8 / BIT_DEPTH;
+            uint8_t shift = static_cast<uint8_t>(8 - BIT_DEPTH * (index % SAMPLES_PER_BYTE + 1));
+            return (src[index / SAMPLES_PER_BYTE] >> shift) & MASK;
         }
 
-        int alpha = (1 << m_bit_depth) - 1; // fully opaque
-
-        if (m_bit_depth == 8) {
-            uint8_t red;
-            uint8_t green;
-            uint8_t blue;
-
-            utils::read_data_as_host_endian(
-                reinterpret_cast<unsigned char*> (data.data() + position),
-                &red,
-                sizeof(red),
-                "Unable to read red channel of pixel at position " + std::to_string(position)
-            );
-
-            position += sizeof(red);
-
-
-            utils::read_data_as_host_endian(
-                reinterpret_cast<unsigned char*> (data.data() + position),
-                &green,
-                sizeof(green),
-                "Unable to read green channel of pixel at position " + std::to_string(position)
-            );
-
-            position += sizeof(green);
-
-
-            utils::read_data_as_host_endian(
-                reinterpret_cast<unsigned char*> (data.data() + position),
-                &blue,
-                sizeof(blue),
-                "Unable to read blue channel of pixel at position " + std::to_string(position)
-            );
-
-            position += sizeof(blue);
-
-            return std::make_optional<RGB> (RGB{ red, green, blue, alpha });
+        // 8-bit channels keep the high byte of 16-bit samples, 16-bit channels replicate 8-bit ones (0xab -> 0xabab)
+        template <uint8_t BIT_DEPTH>
+        uint8_t to_8_bits(uint16_t sample) {
+            return static_cast<uint8_t>(BIT_DEPTH == 16 ? sample >> 8 : sample);
         }
-        else if (m_bit_depth == 16) {
-            uint16_t red;
-            uint16_t green;
-            uint16_t blue;
-
-            utils::read_data_as_big_endian_and_convert_to_host_endianess(
-                reinterpret_cast<unsigned char*> (data.data() + position),
-                &red,
-                sizeof(red),
-                "Unable to read red channel of pixel at position " + std::to_string(position)
-            );
-
-            position += sizeof(red);
-
 
-            utils::read_data_as_big_endian_and_convert_to_host_endianess(
-                reinterpret_cast<unsigned char*> (data.data() + position),
-                &green,
-                sizeof(green),
-                "Unable to read green channel of pixel at position " + std::to_string(position)
-            );
-
-            position += sizeof(green);
-
-
-            utils::read_data_as_big_endian_and_convert_to_host_endianess(
-                reinterpret_cast<unsigned char*> (data.data() + position),
-                &blue,
-                sizeof(blue),
-                "Unable to read blue channel of pixel at position " + std::to_string(position)
-            );
-
-            position += sizeof(blue);
-
-            return std::make_optional<RGB> (RGB{ red, green, blue, alpha });
+        template <uint8_t BIT_DEPTH>
+        uint16_t to_16_bits(uint16_t sample) {
+            return static_cast<uint16_t>(BIT_DEPTH == 16 ? sample : sample * 0x101);
         }
-        
-        throw ::error::invalid_arguments("m_bit_depth must be 8 or 16");
-    }
 
-
-    // RGB with alpha
-    RGBWithAlphaPixelReader::RGBWithAlphaPixelReader(uint8_t bit_depth, Pallete& pallete): PixelReader(bit_depth, pallete) {}
-
-    std::optional<RGB> RGBWithAlphaPixelReader::get_pixel_at(std::vector<uint8_t>& data, size_t index, size_t bits_per_pixel) {
-        size_t position = index * (bits_per_pixel / 8);
-        
-        if (position >= data.size()) {
-            return std::nullopt;
+        // a pixel of the output format from `BIT_DEPTH` (8 or 16) bit samples, the gray formats hold the luma
+        // of color pixels (see `FromRGBA16`)
+        template <class Pixel, uint8_t BIT_DEPTH>
+        Pixel make_pixel(uint16_t red, uint16_t green, uint16_t blue, uint16_t alpha) {
+            if constexpr (std::is_same_v<Pixel, RGBA8>) {
+                return RGBA8{ to_8_bits<BIT_DEPTH>(red), to_8_bits<BIT_DEPTH>(green), to_8_bits<BIT_DEPTH>(blue), to_8_bits<BIT_DEPTH>(alpha) };
+            }
+            else if constexpr (std::is_same_v<Pixel, RGB8>) {
+                return RGB8{ to_8_bits<BIT_DEPTH>(red), to_8_bits<BIT_DEPTH>(green), to_8_bits<BIT_DEPTH>(blue) };
+            }
+            else {
+                return FromRGBA16<Pixel>(RGBA16{ to_16_bits<BIT_DEPTH>(red), to_16_bits<BIT_DEPTH>(green), to_16_bits<BIT_DEPTH>(blue), to_16_bits<BIT_DEPTH>(alpha) });
+            }
         }
 
-
-        if (m_bit_depth == 8) {
-            uint8_t red;
-            uint8_t green;
-            uint8_t blue;
-            uint8_t alpha;
-
-            utils::read_data_as_host_endian(
-                reinterpret_cast<unsigned char*> (data.data() + position),
-                &red,
-                sizeof(red),
-                "Unable to read red channel of pixel at position " + std::to_string(position)
-            );
-
-            position += sizeof(red);
-
-
-            utils::read_data_as_host_endian(
-                reinterpret_cast<unsigned char*> (data.data() + position),
-                &green,
-                sizeof(green),
-                "Unable to read green channel of pixel at position " + std::to_string(position)
-            );
-
-            position += sizeof(green);
-
-
-            utils::read_data_as_host_endian(
-                reinterpret_cast<unsigned char*> (data.data() + position),
-                &blue,
-                sizeof(blue),
-                "Unable to read blue channel of pixel at position " + std::to_string(position)
-            );
-
-            position += sizeof(blue);
-
-
-            utils::read_data_as_host_endian(
-                reinterpret_cast<unsigned char*> (data.data() + position),
-                &alpha,
-                sizeof(alpha),
-                "Unable to read alpha channel of pixel at position " + std::to_string(position)
-            );
-
-            position += sizeof(alpha);
-
-            return std::make_optional<RGB> (RGB{ red, green, blue, alpha });
+        template <class Pixel, uint8_t BIT_DEPTH>
+        Pixel make_grey_pixel(uint16_t grey_scale, uint16_t alpha) {
+            if constexpr (std::is_same_v<Pixel, Gray8>) {
+                return Gray8{ to_8_bits<BIT_DEPTH>(grey_scale) };
+            }
+            else if constexpr (std::is_same_v<Pixel, GrayA8>) {
+                return GrayA8{ to_8_bits<BIT_DEPTH>(grey_scale), to_8_bits<BIT_DEPTH>(alpha) };
+            }
+            else {
+                return make_pixel<Pixel, BIT_DEPTH>(grey_scale, grey_scale, grey_scale, alpha);
+            }
         }
-        else if (m_bit_depth == 16) {
-            uint16_t red;
-            uint16_t green;
-            uint16_t blue;
-            uint16_t alpha;
-
-            utils::read_data_as_big_endian_and_convert_to_host_endianess(
-                reinterpret_cast<unsigned char*> (data.data() + position),
-                &red,
-                sizeof(red),
-                "Unable to read red channel of pixel at position " + std::to_string(position)
-            );
-
-            position += sizeof(red);
-
 
-            utils::read_data_as_big_endian_and_convert_to_host_endianess(
-                reinterpret_cast<unsigned char*> (data.data() + position),
-                &green,
-                sizeof(green),
-                "Unable to read green channel of pixel at position " + std::to_string(position)
-            );
+        template <uint8_t BIT_DEPTH>
+        constexpr uint16_t OPAQUE = BIT_DEPTH == 16 ? 0xffff : 0xff;
 
-            position += sizeof(green);
-
-
-            utils::read_data_as_big_endian_and_convert_to_host_endianess(
-                reinterpret_cast<unsigned char*> (data.data() + position),
-                &blue,
-                sizeof(blue),
-                "Unable to read blue channel of pixel at position " + std::to_string(position)
-            );
-
-            position += sizeof(blue);
-
-            
-            utils::read_data_as_big_endian_and_convert_to_host_endianess(
-                reinterpret_cast<unsigned char*> (data.data() + position),
-                &alpha,
-                sizeof(alpha),
-                "Unable to read alpha channel of pixel at position " + std::to_string(position)
-            );
-
-            position += sizeof(alpha);
+        template <class Pixel, uint8_t BIT_DEPTH>
+        void convert_greyscale(const uint8_t* src, size_t width, void* dst, const void*) {
+            Pixel* pixels = static_cast<Pixel*>(dst);
+            if constexpr (BIT_DEPTH == 8 && std::is_same_v<Pixel, Gray8>) {
+                // the scanline already is packed Gray8
+                std::memcpy(pixels, src, width * sizeof(Pixel));
+                return;
+            }
 
-            return std::make_optional<RGB> (RGB{ red, green, blue, alpha });
+            for (size_t x = 0; x < width; ++x) {
+                if constexpr (BIT_DEPTH < 8) {
+                    // stretched over the 8-bit range: 1 -> 255, 3 -> 85, 15 -> 17 times the value
+                    uint8_t grey_scale = packed_sample_at<BIT_DEPTH>(src, x) * (0xff / ((1 << BIT_DEPTH) - 1));
+                    pixels[x] = make_grey_pixel<Pixel, 8>(grey_scale, 0xff);
+                }
+                else {
+                    pixels[x] = make_grey_pixel<Pixel, BIT_DEPTH>(sample_at<BIT_DEPTH>(src, x), OPAQUE<BIT_DEPTH>);
+                }
+            }
         }
 
-        
-        throw ::error::invalid_arguments("m_bit_depth must be 8 or 16");
-    }
-
-
-    // Greysacle 
-    GreyScalePixelReader::GreyScalePixelReader(uint8_t bit_depth, Pallete& pallete): PixelReader(bit_depth, pallete) {}
-
-    std::optional<RGB> GreyScalePixelReader::get_pixel_at(std::vector<uint8_t>& data, size_t index, size_t bits_per_pixel) {
-        size_t position;
-        int alpha = (1 << m_bit_depth) - 1; // fully opaque
-
-        if (m_bit_depth < 8) {
-            position = (index * bits_per_pixel) / 8;
-            if (position >= data.size()) {
-                return std::nullopt;
+        template <class Pixel, uint8_t BIT_DEPTH>
+        void convert_greyscale_with_alpha(const uint8_t* src, size_t width, void* dst, const void*) {
+            Pixel* pixels = static_cast<Pixel*>(dst);
+            if constexpr (BIT_DEPTH == 8 && std::is_same_v<Pixel, GrayA8>) {
+                std::memcpy(pixels, src, width * sizeof(Pixel));
+                return;
             }
-            
-            uint8_t block_position_in_byte = index % (8 / bits_per_pixel);
-            
-            int grey_scale = BitReader::get_value_from_byte(
-                data[position],
-                block_position_in_byte,
-                m_bit_depth
-            );
 
-            return std::make_optional<RGB> (RGB{ grey_scale, grey_scale, grey_scale, alpha });
+            for (size_t x = 0; x < width; ++x) {
+                pixels[x] = make_grey_pixel<Pixel, BIT_DEPTH>(sample_at<BIT_DEPTH>(src, 2 * x), sample_at<BIT_DEPTH>(src, 2 * x + 1));
+            }
         }
-        else if (m_bit_depth == 8) {
-            position = index * (bits_per_pixel / 8);
 
-            if (position >= data.size()) {
-                return std::nullopt;
+        template <class Pixel, uint8_t BIT_DEPTH>
+        void convert_rgb(const uint8_t* src, size_t width, void* dst, const void*) {
+            Pixel* pixels = static_cast<Pixel*>(dst);
+            if constexpr (BIT_DEPTH == 8 && std::is_same_v<Pixel, RGB8>) {
+                std::memcpy(pixels, src, width * sizeof(Pixel));
+                return;
             }
 
-            uint8_t grey_scale;
-
-            utils::read_data_as_host_endian(
-                reinterpret_cast<unsigned char*> (data.data() + position),
-                &grey_scale,
-                sizeof(grey_scale),
-                "Unable to read grey scale channel of pixel at position " + std::to_string(position)
-            );
-
-            position += sizeof(grey_scale);
-
-            return std::make_optional<RGB> (RGB{ grey_scale, grey_scale, grey_scale, alpha });
+            for (size_t x = 0; x < width; ++x) {
+                pixels[x] = make_pixel<Pixel, BIT_DEPTH>(sample_at<BIT_DEPTH>(src, 3 * x), sample_at<BIT_DEPTH>(src, 3 * x + 1), sample_at<BIT_DEPTH>(src, 3 * x + 2), OPAQUE<BIT_DEPTH>);
+            }
         }
-        else if (m_bit_depth == 16) {    
-            position = index * (bits_per_pixel / 8);
 
-            if (position >= data.size()) {
-                return std::nullopt;
+        template <class Pixel, uint8_t BIT_DEPTH>
+        void convert_rgb_with_alpha(const uint8_t* src, size_t width, void* dst, const void*) {
+            Pixel* pixels = static_cast<Pixel*>(dst);
+            if constexpr (BIT_DEPTH == 8 && std::is_same_v<Pixel, RGBA8>) {
+                std::memcpy(pixels, src, width * sizeof(Pixel));
+                return;
             }
-            
-            uint16_t grey_scale;
-
-            utils::read_data_as_big_endian_and_convert_to_host_endianess(
-                reinterpret_cast<unsigned char*> (data.data() + position),
-                &grey_scale,
-                sizeof(grey_scale),
-                "Unable to read grey scale channel of pixel at position " + std::to_string(position)
-            );
 
-            position += sizeof(grey_scale);
-
-            return std::make_optional<RGB> (RGB{ grey_scale, grey_scale, grey_scale, alpha });
+            for (size_t x = 0; x < width; ++x) {
+                pixels[x] = make_pixel<Pixel, BIT_DEPTH>(sample_at<BIT_DEPTH>(src, 4 * x), sample_at<BIT_DEPTH>(src, 4 * x + 1), sample_at<BIT_DEPTH>(src, 4 * x + 2), sample_at<BIT_DEPTH>(src, 4 * x + 3));
+            }
         }
 
-        throw ::error::invalid_arguments("m_bit_depth must be 8 or 16");
-    }
-
-
-    // Greysacle with alpha
-    GreyScaleWithAlphaPixelReader::GreyScaleWithAlphaPixelReader(uint8_t bit_depth, Pallete& pallete): PixelReader(bit_depth, pallete) {}
-
-    std::optional<RGB> GreyScaleWithAlphaPixelReader::get_pixel_at(std::vector<uint8_t>& data, size_t index, size_t bits_per_pixel) {
-        size_t position = index * (bits_per_pixel / 8);
-        if (position >= data.size()) {
-            return std::nullopt;
+        template <class Pixel, uint8_t BIT_DEPTH>
+        void convert_pallete(const uint8_t* src, size_t width, void* dst, const void* pallete) {
+            Pixel* pixels = static_cast<Pixel*>(dst);
+            const Pixel* colors = static_cast<const Pixel*>(pallete);
+            for (size_t x = 0; x < width; ++x) {
+                if constexpr (BIT_DEPTH < 8) {
+                    pixels[x] = colors[packed_sample_at<BIT_DEPTH>(src, x)];
+                }
+                else {
+                    pixels[x] = colors[src[x]];
+                }
+            }
         }
 
-        if (m_bit_depth == 8) {
-            uint8_t grey_scale;
-            uint8_t alpha;
-
-            utils::read_data_as_host_endian(
-                reinterpret_cast<unsigned char*> (data.data() + position),
-                &grey_scale,
-                sizeof(grey_scale),
-                "Unable to read grey scale channel of pixel at position " + std::to_string(position)
-            );
-
-            position += sizeof(grey_scale);
-
-            utils::read_data_as_host_endian(
-                reinterpret_cast<unsigned char*> (data.data() + position),
-                &alpha,
-                sizeof(alpha),
-                "Unable to read alpha channel of pixel at position " + std::to_string(position)
-            );
-
-            position += sizeof(alpha);
+        template <class Pixel>
+        PixelReader::RowConverter get_converter(PixelReader::PixelType pixel_type, uint8_t bit_depth) {
+            switch (pixel_type) {
+                case PixelReader::PixelType::GREYSCALE:
+                    switch (bit_depth) {
+                        case 1: return convert_greyscale<Pixel, 1>;
+                        case 2: return convert_greyscale<Pixel, 2>;
+                        case 4: return convert_greyscale<Pixel, 4>;
+                        case 8: return convert_greyscale<Pixel, 8>;
+                        case 16: return convert_greyscale<Pixel, 16>;
+                    }
+                    break;
+                case PixelReader::PixelType::GRAYSCALE_WITH_ALPHA:
+                    switch (bit_depth) {
+                        case 8: return convert_greyscale_with_alpha<Pixel, 8>;
+                        case 16: return convert_greyscale_with_alpha<Pixel, 16>;
+                    }
+                    break;
+                case PixelReader::PixelType::RGB:
+                    switch (bit_depth) {
+                        case 8: return convert_rgb<Pixel, 8>;
+                        case 16: return convert_rgb<Pixel, 16>;
+                    }
+                    break;
+                case PixelReader::PixelType::RGB_WITH_ALPHA:
+                    switch (bit_depth) {
+                        case 8: return convert_rgb_with_alpha<Pixel, 8>;
+                        case 16: return convert_rgb_with_alpha<Pixel, 16>;
+                    }
+                    break;
+                case PixelReader::PixelType::PALLETE:
+                    switch (bit_depth) {
+                        case 1: return convert_pallete<Pixel, 1>;
+                        case 2: return convert_pallete<Pixel, 2>;
+                        case 4: return convert_pallete<Pixel, 4>;
+                        case 8: return convert_pallete<Pixel, 8>;
+                    }
+                    break;
+            }
 
-            return std::make_optional<RGB> (RGB{ grey_scale, grey_scale, grey_scale, alpha });
+            throw ::error::invalid_arguments("PixelReader: unsupported bit depth " + std::to_string(bit_depth) + " for pixel type " + std::to_string(static_cast<int>(pixel_type)));
         }
-        else if (m_bit_depth == 16) {
-            uint16_t grey_scale;
-            uint16_t alpha;
 
-            utils::read_data_as_big_endian_and_convert_to_host_endianess(
-                reinterpret_cast<unsigned char*> (data.data() + position),
-                &grey_scale,
-                sizeof(grey_scale),
-                "Unable to read grey scale channel of pixel at position " + std::to_string(position)
-            );
-
-            position += sizeof(grey_scale);
-            
-            utils::read_data_as_big_endian_and_convert_to_host_endianess(
-                reinterpret_cast<unsigned char*> (data.data() + position),
-                &alpha,
-                sizeof(alpha),
-                "Unable to read alpha channel of pixel at position " + std::to_string(position)
-            );
-
-            position += sizeof(alpha);
-
-            return std::make_optional<RGB> (RGB{ grey_scale, grey_scale, grey_scale, alpha });
+        template <class Pixel>
+        void fill_pallete(const Pallete& pallete, void* colors) {
+            Pixel* pixels = static_cast<Pixel*>(colors);
+            for (size_t i = 0; i < 256; ++i) {
+                PalleteColor color = i < pallete.entries.size() ? pallete.entries[i] : PalleteColor{ 0, 0, 0 };
+                pixels[i] = make_pixel<Pixel, 8>(color.red, color.green, color.blue, 0xff);
+            }
         }
 
-        throw ::error::invalid_arguments("m_bit_depth must be 8 or 16");
-    }
-
-
-    // Pallete
-    PalletePixelReader::PalletePixelReader(uint8_t bit_depth, Pallete& pallete): PixelReader(bit_depth, pallete) {}
-
-    std::optional<RGB> PalletePixelReader::get_pixel_at(std::vector<uint8_t>& data, size_t index, size_t bits_per_pixel) {
-        size_t position;
-        int alpha = (1 << 8) - 1; // fully opaque, for pallete each color sergment is 1 byte
-
-        if (m_bit_depth < 8) {
-            position = (index * bits_per_pixel) / 8;
-            if (position >= data.size()) {
-                return std::nullopt;
+        // calls `function.template operator()<Pixel>()` with the pixel struct of `format`
+        template <class Function>
+        auto visit_pixel_format(PixelFormat format, Function&& function) {
+            switch (format) {
+                case PixelFormat::GRAY8: return function.template operator()<Gray8>();
+                case PixelFormat::GRAY_ALPHA8: return function.template operator()<GrayA8>();
+                case PixelFormat::RGB8: return function.template operator()<RGB8>();
+                case PixelFormat::RGBA8: return function.template operator()<RGBA8>();
+                case PixelFormat::RGBA16: return function.template operator()<RGBA16>();
             }
-
-            
-            uint8_t block_position_in_byte = index % (8 / bits_per_pixel);
-            
-            int index_in_pallete_table = BitReader::get_value_from_byte(
-                data[position],
-                block_position_in_byte,
-                m_bit_depth
-            );
-
-            PalleteColor color = m_pallete.entries[index_in_pallete_table];
-            return std::make_optional<RGB> (RGB{ color.red, color.green, color.blue, alpha });
+            throw ::error::invalid_arguments("PixelReader: unknown output format " + std::to_string(static_cast<int>(format)));
         }
-        else if (m_bit_depth == 8) {
-            position = index * (bits_per_pixel / 8);
-            if (position >= data.size()) {
-                return std::nullopt;
-            }
 
-            uint8_t index_in_pallete_table;
+    } // namespace
 
-            utils::read_data_as_host_endian(
-                reinterpret_cast<unsigned char*> (data.data() + position),
-                &index_in_pallete_table,
-                sizeof(index_in_pallete_table),
-                "Unable to read pallete index at position " + std::to_string(position)
-            );
-
-            position += sizeof(index_in_pallete_table);
-            
-            PalleteColor color = m_pallete.entries[index_in_pallete_table];
-
-            return std::make_optional<RGB> (RGB{ color.red, color.green, color.blue, alpha });
-        }
+    PixelReader::PixelReader(PixelType pixel_type, uint8_t bit_depth, const Pallete& pallete, PixelFormat output_format):
+        m_output_format(output_format),
+        m_pallete{} {
+        m_converter = visit_pixel_format(output_format, [&]<class Pixel>() {
+            fill_pallete<Pixel>(pallete, m_pallete.data());
+            return get_converter<Pixel>(pixel_type, bit_depth);
+        });
+    }
 
-        throw ::error::invalid_arguments("m_bit_depth must be 1, 2, 4 or 8");
+    std::unique_ptr<PixelReader> PixelReader::create_pixel_reader(PixelType pixel_type, uint8_t bit_depth, const Pallete& pallete, PixelFormat output_format) {
+        return std::make_unique<PixelReader>(pixel_type, bit_depth, pallete, output_format);
     }
 
+    void PixelReader::throw_format_mismatch(PixelFormat format) const {
+        throw ::error::invalid_arguments("PixelReader: converts into format " + std::to_string(static_cast<int>(m_output_format)) + ", not " + std::to_string(static_cast<int>(format)));
+    }
 
 } // namespace png_decoder
-
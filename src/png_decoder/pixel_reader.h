@@ -3,9 +3,9 @@
 
 // stl includes
 #include <cstdint>
+#include <cstddef>
 #include <memory>
-#include <vector>
-#include <optional>
+#include <array>
 
 // custom includes
 #include "../../image.h"
@@ -13,6 +13,9 @@
 
 namespace png_decoder {
 
+    // Converts defiltered scanlines into image pixels of one output format a row at a time. The conversion for the
+    // pixel type, bit depth and output format is picked once, when the reader is created; pallete colors are
+    // converted into the output format then and looked up in a table.
     class PixelReader {
     public:
         enum class PixelType : uint8_t {
@@ -23,46 +26,34 @@ namespace png_decoder {
             RGB_WITH_ALPHA = 4
         };
 
-        PixelReader(uint8_t bit_depth, Pallete& pallete);
-        static std::unique_ptr<PixelReader> create_pixel_reader(PixelType pixel_type, uint8_t bit_depth, Pallete& pallete);
-
-        virtual std::optional<RGB> get_pixel_at(std::vector<uint8_t>& data, size_t position, size_t bits_per_pixel) = 0;
-        virtual ~PixelReader() = default;
-    protected:
-        uint8_t m_bit_depth;
-        Pallete& m_pallete;
-    };
-
-    class RGBPixelReader : public PixelReader {
-    public:
-        RGBPixelReader(uint8_t bit_depth, Pallete& pallete);
-        virtual std::optional<RGB> get_pixel_at(std::vector<uint8_t>& data, size_t position, size_t bits_per_pixel) override;
-    };
-
-    
-    class RGBWithAlphaPixelReader : public PixelReader {
-    public:
-        RGBWithAlphaPixelReader(uint8_t bit_depth, Pallete& pallete);
-        virtual std::optional<RGB> get_pixel_at(std::vector<uint8_t>& data, size_t position, size_t bits_per_pixel) override;
-    };
-
-    class GreyScalePixelReader : public PixelReader {
-    public:
-        GreyScalePixelReader(uint8_t bit_depth, Pallete& pallete);
-        virtual std::optional<RGB> get_pixel_at(std::vector<uint8_t>& data, size_t position, size_t bits_per_pixel) override;
-    };
-
-
-    class GreyScaleWithAlphaPixelReader : public PixelReader {
-    public:
-        GreyScaleWithAlphaPixelReader(uint8_t bit_depth, Pallete& pallete);
-        virtual std::optional<RGB> get_pixel_at(std::vector<uint8_t>& data, size_t position, size_t bits_per_pixel) override;
-    };
-
-    class PalletePixelReader : public PixelReader {
-    public:
-        PalletePixelReader(uint8_t bit_depth, Pallete& pallete);
-        virtual std::optional<RGB> get_pixel_at(std::vector<uint8_t>& data, size_t position, size_t bits_per_pixel) override;
+        // converts the first `width` pixels of the scanline at `src` (without the filter type byte) into `dst`,
+        // an array of pixels of the output format
+        using RowConverter = void (*)(const uint8_t* src, size_t width, void* dst, const void* pallete);
+
+        // throws `::error::invalid_arguments` for a bit depth the pixel type does not allow
+        PixelReader(PixelType pixel_type, uint8_t bit_depth, const Pallete& pallete, PixelFormat output_format = PixelFormat::RGBA8);
+        static std::unique_ptr<PixelReader> create_pixel_reader(PixelType pixel_type, uint8_t bit_depth, const Pallete& pallete, PixelFormat output_format = PixelFormat::RGBA8);
+
+        // `Pixel` must be the output format
+        template <class Pixel>
+        void convert_row(const uint8_t* src, size_t width, Pixel* dst) const {
+            if (Pixel::LAYOUT.format != m_output_format) {
+                throw_format_mismatch(Pixel::LAYOUT.format);
+            }
+            m_converter(src, width, dst, m_pallete.data());
+        }
+
+        PixelFormat get_output_format() const noexcept {
+            return m_output_format;
+        }
+
+    private:
+        PixelFormat m_output_format;
+        RowConverter m_converter;
+        // 256 pallete colors in the output format, indices past the last entry are opaque black
+        alignas(alignof(RGBA16)) std::array<uint8_t, 256 * sizeof(RGBA16)> m_pallete;
+
+        [[noreturn]] void throw_format_mismatch(PixelFormat format) const;
     };
 
 }
@@ -7,71 +7,218 @@
 #include <optional>
 #include <algorithm>
 #include <set>
+#include <span>
+#include <thread>
+#include <future>
+#include <atomic>
+#include <limits>
+#include <array>
 
 // custom includes
 #include "../errors.h"
 #include "../utils.h"
 #include "../crc_calculator/crc_calculator.h"
 #include "../inflater/inflater.h"
-#include "defilter.h"
+#include "../inflater/stream_inflater.h"
+#include "defilter_kernels.h"
+#include "mapped_file.h"
 #include "pixel_reader.h"
 
-Image ReadPng(std::string_view filename) {
+template <class Pixel>
+BasicImage<Pixel> ReadPng(std::string_view filename, const png_decoder::DecoderOptions& options) {
+    png_decoder::DecoderContext context;
+    return ReadPng<Pixel>(filename, context, options);
+}
+
+template <class Pixel>
+BasicImage<Pixel> ReadPng(std::string_view filename, png_decoder::DecoderContext& context, const png_decoder::DecoderOptions& options) {
     std::ifstream input_stream(filename.data(), std::ios_base::binary | std::ios_base::in);
 
     if (!input_stream || !input_stream.is_open()) {
         throw error::unable_to_open_file(std::string(filename));
     }
 
-    png_decoder::PNGDecoder decoder = png_decoder::PNGDecoder(input_stream);
-    Image img = decoder.decode();
+    png_decoder::PNGDecoder decoder(input_stream, context, options);
+    BasicImage<Pixel> img = decoder.decode<Pixel>();
 
     input_stream.close();
 
     return img;
 }
 
+template <class Pixel>
+BasicImage<Pixel> ReadPngMapped(std::string_view filename, const png_decoder::DecoderOptions& options) {
+    png_decoder::DecoderContext context;
+    return ReadPngMapped<Pixel>(filename, context, options);
+}
+
+template <class Pixel>
+BasicImage<Pixel> ReadPngMapped(std::string_view filename, png_decoder::DecoderContext& context, const png_decoder::DecoderOptions& options) {
+    png_decoder::MappedFile file(filename);
+    return DecodePng<Pixel>(file.get_data(), context, options);
+}
+
+template <class Pixel>
+BasicImage<Pixel> DecodePng(std::span<const uint8_t> data, const png_decoder::DecoderOptions& options) {
+    png_decoder::DecoderContext context;
+    return DecodePng<Pixel>(data, context, options);
+}
+
+template <class Pixel>
+BasicImage<Pixel> DecodePng(std::span<const uint8_t> data, png_decoder::DecoderContext& context, const png_decoder::DecoderOptions& options) {
+    png_decoder::PNGDecoder decoder(data, context, options);
+    return decoder.decode<Pixel>();
+}
+
 namespace png_decoder {
 
-    PNGDecoder::PNGDecoder(std::istream& stream): m_stream(stream), m_header({}), m_pallete({}) {}
+    PNGDecoder::PNGDecoder(std::istream& stream, DecoderOptions options):
+        m_stream(&stream),
+        m_input_position(0),
+        m_options(options),
+        m_own_context(std::make_unique<DecoderContext>()),
+        m_context(*m_own_context),
+        m_chunks(m_context.get_chunks()),
+        m_image_data(m_context.get_image_data()),
+        m_header({}),
+        m_pallete({}),
+        m_is_data_crc_deferred(false),
+        m_is_data_chunk_read(false),
+        m_input_chunk_count(0),
+        m_output_layout(RGBA8::LAYOUT),
+        m_reserved_memory(0) {}
+
+    PNGDecoder::PNGDecoder(std::istream& stream, DecoderContext& context, DecoderOptions options):
+        m_stream(&stream),
+        m_input_position(0),
+        m_options(options),
+        m_context(context),
+        m_chunks(m_context.get_chunks()),
+        m_image_data(m_context.get_image_data()),
+        m_header({}),
+        m_pallete({}),
+        m_is_data_crc_deferred(false),
+        m_is_data_chunk_read(false),
+        m_input_chunk_count(0),
+        m_output_layout(RGBA8::LAYOUT),
+        m_reserved_memory(0) {}
+
+    PNGDecoder::PNGDecoder(std::span<const uint8_t> data, DecoderOptions options):
+        m_stream(nullptr),
+        m_input(data),
+        m_input_position(0),
+        m_options(options),
+        m_own_context(std::make_unique<DecoderContext>()),
+        m_context(*m_own_context),
+        m_chunks(m_context.get_chunks()),
+        m_image_data(m_context.get_image_data()),
+        m_header({}),
+        m_pallete({}),
+        m_is_data_crc_deferred(false),
+        m_is_data_chunk_read(false),
+        m_input_chunk_count(0),
+        m_output_layout(RGBA8::LAYOUT),
+        m_reserved_memory(0) {}
+
+    PNGDecoder::PNGDecoder(std::span<const uint8_t> data, DecoderContext& context, DecoderOptions options):
+        m_stream(nullptr),
+        m_input(data),
+        m_input_position(0),
+        m_options(options),
+        m_context(context),
+        m_chunks(m_context.get_chunks()),
+        m_image_data(m_context.get_image_data()),
+        m_header({}),
+        m_pallete({}),
+        m_is_data_crc_deferred(false),
+        m_is_data_chunk_read(false),
+        m_input_chunk_count(0),
+        m_output_layout(RGBA8::LAYOUT),
+        m_reserved_memory(0) {}
+
+    template <class Pixel>
+    BasicImage<Pixel> PNGDecoder::decode() {
+        // per-decode buffers are released in one shot when leaving, also on errors;
+        // locals holding arena memory are destroyed before the guard runs
+        struct DecodeScope {
+            DecoderContext& context;
+            ~DecodeScope() {
+                context.end_decode();
+            }
+        } decode_scope{ m_context };
+
+        m_context.begin_decode();
+        m_reserved_memory = 0;
+        m_output_layout = Pixel::LAYOUT;
+        m_is_data_chunk_read = false;
+        m_input_chunk_count = 0;
+        m_chunk_numbers.clear();
+        m_late_crc_mismatch.reset();
+        m_is_data_crc_deferred = m_options.verify_crc && m_options.parallel_crc && worker_count(std::numeric_limits<size_t>::max()) > 1;
 
-    Image PNGDecoder::decode() {
         // signature
         validate_png_signature_valid(read_png_signature());
         
-        // chunks
+        // chunks, the header is read and checked against the limits on the way
         read_all_chunks();
         validate_chunks();
 
-        // read header
-        read_header();
-        validate_header();
         if (m_header.is_pallete_indexed()) {
             read_pallete();
             validate_pallete();
         }
 
-        // inflation
-        inflate_data_chunks();
-
-        // defilter
-        auto intermediate_images = defilter();
+        // IDAT crcs are verified on worker threads while the image data is inflated
+        std::optional<CrcVerifier> crc_verifier;
+        start_data_crc_verification(crc_verifier);
 
-        // create image
-        Image result = create_image(intermediate_images);
+        // inflation, defilter and image creation, independently compressed segments are processed in parallel
+        BasicImage<Pixel> result;
+        try {
+            if (m_options.pipelined_rows) {
+                result = inflate_and_convert_rows_pipelined<Pixel>();
+            }
+            else if (m_options.fused_rows) {
+                result = inflate_and_convert_rows<Pixel>();
+            }
+            else {
+                std::vector <IntermediateImage> intermediate_images;
+                if (!inflate_and_defilter_segments(intermediate_images)) {
+                    inflate_data_chunks();
+                    intermediate_images = defilter();
+                }
+                result = create_image<Pixel>(intermediate_images);
+            }
+        }
+        catch (...) {
+            // corrupt data usually breaks the inflate as well, the crc mismatch is reported instead
+            finish_data_crc_verification(crc_verifier);
+            throw;
+        }
+        finish_data_crc_verification(crc_verifier);
 
         return result;
     }
 
     uint64_t PNGDecoder::read_png_signature() {
         uint64_t signature;
+
+        if (m_stream == nullptr) {
+            if (m_input.size() < sizeof(signature)) {
+                throw error::unable_to_read_from_source("Cannot read png signature");
+            }
+            std::memcpy(&signature, m_input.data(), sizeof(signature));
+            m_input_position = sizeof(signature);
+            return utils::convert_from_big_endian_to_host(signature);
+        }
         
         utils::read_stream_as_big_endian_and_convert_to_host_endianess(
-            m_stream,
+            *m_stream,
             &signature,
             sizeof(signature),
             "Cannot read png signature"
         );
+        m_input_position = sizeof(signature);
   
         return signature;
     }
@@ -90,20 +237,52 @@ namespace png_decoder {
                 break;
             }
             // std::cout << chunk.value().to_string(false) << std::endl;
-            m_chunks.push_back(chunk.value());
+            m_is_data_chunk_read = m_is_data_chunk_read || chunk->get_type() == Chunk::ChunkType::DATA;
+            m_chunks.push_back(std::move(chunk.value()));
+            m_chunk_numbers.push_back(m_input_chunk_count - 1);
+
+            // oversized images are rejected before the rest of the file is read
+            if (m_chunks.size() == 1) {
+                validate_chunks();
+                read_header();
+                validate_header();
+                validate_limits();
+            }
         }
 
         // std::cout << "Total chunks: " << m_chunks.size() << std::endl;
     }
 
     std::optional<Chunk> PNGDecoder::read_chunk() {
+        // chunks which are not retained come back without data and are dropped right away
+        while (true) {
+            std::optional<Chunk> chunk = m_stream != nullptr ? read_chunk_from_stream() : read_chunk_from_memory();
+            if (!chunk.has_value()) {
+                return chunk;
+            }
+            ++m_input_chunk_count;
+            if (is_chunk_retained(chunk->get_tag())) {
+                return chunk;
+            }
+        }
+    }
+
+    std::optional<Chunk> PNGDecoder::read_chunk_from_stream() {
+        std::istream& stream = *m_stream;
+        uint64_t position = m_input_position;
+        // messages are only built when a read fails
+        auto at = [position](const char* field, uint64_t offset) {
+            return [field, position, offset] {
+                return std::string("Cannot read chunk ") + field + " at pos " + std::to_string(position + offset);
+            };
+        };
         uint32_t length;
 
         bool is_read = utils::read_stream_as_big_endian_and_convert_to_host_endianess(
-            m_stream,
+            stream,
             &length,
             sizeof(length),
-            "Cannot read chunk length at pos " + std::to_string(m_stream.tellg())
+            at("length", 0)
         );
 
         if (!is_read) {
@@ -112,32 +291,161 @@ namespace png_decoder {
             // further in the code will be an exception and not the regular EOF event
         }
 
-        char type[5] = {0};
-        std::vector <uint8_t> data(length);
+        uint8_t type[4];
         uint32_t crc;
         
-        utils::read_as_host_endian(
-            m_stream,
-            &type,
-            sizeof(type) - 1,
-            "Cannot read chunk type at pos " + std::to_string(m_stream.tellg())
-        );
+        if (!utils::read_as_host_endian(stream, &type, sizeof(type), at("type", 4))) {
+            throw error::unable_to_read_from_stream(at("type", 4)());
+        }
+        ChunkTag tag = read_chunk_tag(type);
+        if (length > m_options.limits.max_chunk_size) {
+            throw error::limit_exceeded("Chunk " + get_chunk_tag_label(tag) + " at pos " + std::to_string(position) + " is " + std::to_string(length) + " bytes long");
+        }
+        bool is_retained = is_chunk_retained(tag);
+        bool is_crc_checked = is_chunk_crc_checked(tag);
+        uint32_t computed_crc = crc_calculator::update_crc32_checksum(0, type, sizeof(type));
+        m_input_position = position + 3 * sizeof(uint32_t) + length;
+
+        std::span <uint8_t> data;
+        if (is_retained || is_crc_checked) {
+            // retained chunk data lives in the arena until the end of the decode,
+            // other chunks only pass through a small buffer on the way to the crc
+            std::array <uint8_t, SKIPPED_CHUNK_BUFFER_SIZE> buffer;
+            auto* memory_resource = m_context.get_memory_resource();
+            if (is_retained) {
+                // the length comes from the file: the buffer is only allocated whole when the stream is known to
+                // hold the data, otherwise it starts at one block and grows as the data arrives
+                size_t capacity = length;
+                if (length > CHUNK_READ_BLOCK_SIZE) {
+                    std::optional<uint64_t> remaining = get_remaining_stream_size();
+                    if (remaining.has_value() && remaining.value() < static_cast<uint64_t>(length) + sizeof(crc)) {
+                        throw error::unable_to_read_from_stream("Chunk " + get_chunk_tag_label(tag) + " at pos " + std::to_string(position) + " is " + std::to_string(length) + " bytes long, but only " + std::to_string(remaining.value()) + " bytes are left");
+                    }
+                    if (!remaining.has_value()) {
+                        capacity = CHUNK_READ_BLOCK_SIZE;
+                    }
+                }
+                reserve_memory(capacity, "chunk data");
+                data = std::span <uint8_t>(static_cast<uint8_t*>(memory_resource->allocate(capacity, 1)), capacity);
+            }
+            size_t max_block_size = is_retained ? CHUNK_READ_BLOCK_SIZE : buffer.size();
+
+            // the crc runs over each block right after it is read, while the block is still in cache
+            for (size_t offset = 0; offset < length; offset += max_block_size) {
+                size_t block_size = std::min<size_t>(max_block_size, length - offset);
+                if (is_retained && offset + block_size > data.size()) {
+                    size_t capacity = std::min<size_t>(length, 2 * data.size());
+                    reserve_memory(capacity - data.size(), "chunk data");
+                    auto* grown = static_cast<uint8_t*>(memory_resource->allocate(capacity, 1));
+                    std::memcpy(grown, data.data(), offset);
+                    memory_resource->deallocate(data.data(), data.size(), 1);
+                    data = std::span <uint8_t>(grown, capacity);
+                }
+                uint8_t* block = is_retained ? data.data() + offset : buffer.data();
 
-        utils::read_as_host_endian(
-            m_stream,
-            data.data(),
-            data.size(),
-            "Cannot read chunk data at pos " + std::to_string(m_stream.tellg())
-        );
+                if (!utils::read_as_host_endian(stream, block, block_size, at("data", 8 + offset))) {
+                    throw error::unable_to_read_from_stream(at("data", 8 + offset)());
+                }
+                if (is_crc_checked) {
+                    computed_crc = crc_calculator::update_crc32_checksum(computed_crc, block, block_size);
+                }
+            }
+        }
+        else if (!stream.seekg(length, std::ios_base::cur)) {
+            // streams which cannot seek are read through
+            stream.clear();
+            stream.ignore(length);
+        }
 
-        utils::read_stream_as_big_endian_and_convert_to_host_endianess(
-            m_stream,
-            &crc,
-            sizeof(crc),
-            "Cannot read chunk crc at pos " + std::to_string(m_stream.tellg())
-        );
+        if (!utils::read_stream_as_big_endian_and_convert_to_host_endianess(stream, &crc, sizeof(crc), at("crc", 8 + static_cast<uint64_t>(length)))) {
+            // the data was skipped or cut short
+            throw error::unable_to_read_from_stream(at("crc", 8 + static_cast<uint64_t>(length))());
+        }
+
+        Chunk chunk(tag, data, crc, position);
+        if (is_crc_checked && crc != computed_crc) {
+            report_crc_mismatch(chunk, m_input_chunk_count, computed_crc);
+        }
 
-        return std::make_optional<Chunk> (Chunk(std::string(type), data, crc));
+        return std::make_optional<Chunk> (std::move(chunk));
+    }
+
+    std::optional<uint64_t> PNGDecoder::get_remaining_stream_size() const {
+        std::istream& stream = *m_stream;
+        std::streampos current = stream.tellg();
+        if (current == std::streampos(-1) || !stream.seekg(0, std::ios_base::end)) {
+            stream.clear();
+            return std::nullopt;
+        }
+
+        std::streampos end = stream.tellg();
+        if (!stream.seekg(current) || end == std::streampos(-1) || end < current) {
+            stream.clear();
+            stream.seekg(current);
+            return std::nullopt;
+        }
+        return static_cast<uint64_t>(end - current);
+    }
+
+    std::optional<Chunk> PNGDecoder::read_chunk_from_memory() {
+        // length, type and crc fields around the data
+        const size_t fields_size = 3 * sizeof(uint32_t);
+        size_t position = m_input_position;
+        size_t remaining = m_input.size() - position;
+
+        if (remaining < sizeof(uint32_t)) {
+            // end of input, like EOF of a stream
+            return std::nullopt;
+        }
+
+        const uint8_t* bytes = m_input.data() + position;
+        auto read_word = [bytes](size_t offset) {
+            uint32_t word;
+            std::memcpy(&word, bytes + offset, sizeof(word));
+            return utils::convert_from_big_endian_to_host(word);
+        };
+
+        uint32_t length = read_word(0);
+        if (remaining < fields_size || remaining - fields_size < length) {
+            throw error::unable_to_read_from_source("Chunk at pos " + std::to_string(position) + " exceeds the input");
+        }
+
+        ChunkTag tag = read_chunk_tag(bytes + sizeof(uint32_t));
+        if (length > m_options.limits.max_chunk_size) {
+            throw error::limit_exceeded("Chunk " + get_chunk_tag_label(tag) + " at pos " + std::to_string(position) + " is " + std::to_string(length) + " bytes long");
+        }
+        // the chunk views the input, nothing is copied
+        std::span <const uint8_t> data(bytes + 2 * sizeof(uint32_t), length);
+        uint32_t crc = read_word(2 * sizeof(uint32_t) + length);
+        m_input_position += fields_size + length;
+
+        // chunks which are not retained are still checked, the view is dropped by `read_chunk`
+        Chunk chunk(tag, data, crc, position);
+        if (is_chunk_crc_checked(tag)) {
+            uint32_t computed_crc = chunk.compute_crc();
+            if (crc != computed_crc) {
+                report_crc_mismatch(chunk, m_input_chunk_count, computed_crc);
+            }
+        }
+
+        return std::make_optional<Chunk> (std::move(chunk));
+    }
+
+    bool PNGDecoder::is_chunk_retained(ChunkTag tag) const noexcept {
+        if (!m_options.retained_chunks.has_value() || is_critical_chunk(tag)) {
+            return true;
+        }
+        // segment markers are needed for the parallel inflate
+        if (tag == chunk_tag::iDOT && m_options.parallel_inflate) {
+            return true;
+        }
+
+        const auto& retained = m_options.retained_chunks.value();
+        return std::find(retained.begin(), retained.end(), tag) != retained.end();
+    }
+
+    bool PNGDecoder::is_chunk_crc_checked(ChunkTag tag) const noexcept {
+        return m_options.verify_crc && !(m_is_data_crc_deferred && tag == chunk_tag::IDAT);
     }
 
     void PNGDecoder::validate_chunks() {
@@ -151,30 +459,76 @@ namespace png_decoder {
 
         // - IEND comes last and has zero length
 
-        // - validate CRC
-        validate_chunks_crc_checksum();
+        // - CRC is validated while reading chunks
 
         // - run through all chunks and call if !chunk.is_valid(): throw
         // - IDAT chunks come one after another
     }
 
-    void PNGDecoder::validate_chunks_crc_checksum() {
-        for (size_t i = 0; i < m_chunks.size(); i++) {
-            auto& chunk = m_chunks[i];
-            auto checksum = crc_calculator::get_crc32_checksum(chunk.get_crc_bytes_sequence().data(), chunk.get_crc_bytes_sequence_length());
+    void PNGDecoder::start_data_crc_verification(std::optional<CrcVerifier>& verifier) {
+        if (!m_is_data_crc_deferred) {
+            return;
+        }
 
-            if (chunk.get_crc() != checksum) {
-                // std::cout << "Found invalid crc chunk" << std::endl;
-                throw error::invalid_crc_checksum("Checksum: " + std::to_string(checksum) + ", chunk number " + std::to_string(i) + ": " + chunk.to_string(true));
+        std::vector <size_t> chunk_indices;
+        uint64_t data_size = 0;
+        for (size_t i = 0; i < m_chunks.size(); ++i) {
+            if (m_chunks[i].get_type() == Chunk::ChunkType::DATA) {
+                chunk_indices.push_back(i);
+                data_size += m_chunks[i].get_length();
             }
         }
+
+        // the calling thread inflates meanwhile, small images are verified right away by `finish_data_crc_verification`
+        uint32_t threads = data_size >= m_options.parallel_crc_threshold
+            ? worker_count(std::numeric_limits<size_t>::max()) - 1
+            : 0;
+        verifier.emplace(m_chunks, std::move(chunk_indices), threads);
+
+        // the decode fails either way, only the IDATs before the bad chunk are left to check
+        if (m_late_crc_mismatch.has_value()) {
+            finish_data_crc_verification(verifier);
+        }
     }
 
+    void PNGDecoder::finish_data_crc_verification(std::optional<CrcVerifier>& verifier) {
+        if (!verifier.has_value()) {
+            return;
+        }
+
+        auto mismatch = verifier->wait();
+        verifier.reset();
+        // the lowest-numbered bad chunk is reported, wherever its crc was checked
+        if (mismatch.has_value() && (!m_late_crc_mismatch.has_value() || m_chunk_numbers[mismatch->chunk_index] < m_late_crc_mismatch->first)) {
+            throw crc_mismatch_error(m_chunks[mismatch->chunk_index], m_chunk_numbers[mismatch->chunk_index], mismatch->checksum);
+        }
+        if (m_late_crc_mismatch.has_value()) {
+            throw m_late_crc_mismatch->second;
+        }
+    }
+
+    void PNGDecoder::report_crc_mismatch(const Chunk& chunk, size_t chunk_number, uint32_t checksum) {
+        // corrupt files are rejected as soon as the first bad chunk is read, unless unchecked IDATs precede it
+        if (!m_is_data_crc_deferred || !m_is_data_chunk_read) {
+            throw crc_mismatch_error(chunk, chunk_number, checksum);
+        }
+        if (!m_late_crc_mismatch.has_value()) {
+            m_late_crc_mismatch.emplace(chunk_number, crc_mismatch_error(chunk, chunk_number, checksum));
+        }
+    }
+
+    error::invalid_crc_checksum PNGDecoder::crc_mismatch_error(const Chunk& chunk, size_t chunk_number, uint32_t checksum) {
+        return error::invalid_crc_checksum("Checksum: " + std::to_string(checksum) + ", chunk number " + std::to_string(chunk_number) + ": " + chunk.to_string(false));
+    }
 
     void PNGDecoder::read_header() {
         Chunk& header_chunk = m_chunks[0];
         uint32_t offset = 0;
 
+        if (header_chunk.get_length() != HEADER_LENGTH) {
+            throw error::invalid_header_chunk("Header chunk must be " + std::to_string(HEADER_LENGTH) + " bytes long");
+        }
+
         // width
         utils::read_data_as_big_endian_and_convert_to_host_endianess(
             header_chunk.get_data_bytes() + offset,
@@ -284,6 +638,34 @@ namespace png_decoder {
         // TODO: Validate other fields
     }
 
+    void PNGDecoder::validate_limits() {
+        const DecodeLimits& limits = m_options.limits;
+        uint64_t pixels = static_cast<uint64_t>(m_header.width) * m_header.height;
+
+        if (m_header.width > limits.max_width || m_header.height > limits.max_height || pixels > limits.max_pixels) {
+            throw error::limit_exceeded("Image of " + std::to_string(m_header.width) + "x" + std::to_string(m_header.height) + " pixels");
+        }
+
+        uint64_t inflated_size = inflated_data_size();
+        if (inflated_size > limits.max_inflated_size) {
+            throw error::limit_exceeded("Inflated data of " + std::to_string(inflated_size) + " bytes");
+        }
+
+        // scanlines are defiltered in place in the inflated data, the fused rows only keep two of them next to the
+        // zlib state of the stream inflater (the pipeline reserves its batches when it starts)
+        uint64_t rows_size = 2 * (static_cast<uint64_t>(scanline_length(m_header.width)) + 1);
+        reserve_memory(m_options.fused_rows || m_options.pipelined_rows ? rows_size + inflater::StreamInflater::STATE_SIZE : inflated_size, "inflated data");
+        reserve_memory(pixels * m_output_layout.bytes_per_pixel(), "image");
+    }
+
+    void PNGDecoder::reserve_memory(uint64_t bytes, const char* purpose) {
+        // the reserved amount never exceeds the budget, so the difference does not wrap
+        if (bytes > m_options.limits.max_memory - m_reserved_memory) {
+            throw error::limit_exceeded(std::string("Memory budget of ") + std::to_string(m_options.limits.max_memory) + " bytes, " + purpose + " needs " + std::to_string(bytes) + " more");
+        }
+        m_reserved_memory += bytes;
+    }
+
     void PNGDecoder::read_pallete() {
         // TODO: check for multiple pallete chunks and for other errors
         bool found = false;
@@ -325,31 +707,253 @@ namespace png_decoder {
         // TODO: validation
     }
 
-    void PNGDecoder::inflate_data_chunks() {
-        // merge data chunks in a single vector
-        std::vector <uint8_t> merged_chunks_data;
-        auto fill_with_data = [&merged_chunks_data](const std::vector <uint8_t>& data) {
-            for (uint8_t byte : data) {
-                merged_chunks_data.push_back(byte);
-            }
-        };
-        
+    std::vector <std::span<const uint8_t>> PNGDecoder::get_data_chunks() const {
+        std::vector <std::span<const uint8_t>> data_chunks;
+
         for (auto& chunk : m_chunks) {
             if (chunk.get_type() == Chunk::ChunkType::DATA) {
-                fill_with_data(chunk.get_data());
+                data_chunks.emplace_back(chunk.get_data());
             }
         }
 
-        // inflate
-        m_image_data = inflater::Inflater().inflate(merged_chunks_data);
+        return data_chunks;
+    }
+
+    void PNGDecoder::inflate_data_chunks() {
+        // views over data chunks, they are inflated in place without merging
+        std::vector <std::span<const uint8_t>> data_chunks = get_data_chunks();
+
+        // inflate straight into a buffer of the size derived from the header
+        m_image_data.resize(inflated_data_size());
+        auto& inflater = m_context.get_inflater(m_options.inflate_backend);
+
+        // the speculative ranges are counted against the memory budget, a stream they do not fit in is inflated
+        // serially
+        uint32_t speculative_threads = m_options.speculative_inflate ? worker_count(std::numeric_limits<size_t>::max()) : 0;
+        uint64_t speculative_memory = 0;
+        size_t compressed_size = 0;
+        for (const auto& data_chunk : data_chunks) {
+            compressed_size += data_chunk.size();
+        }
+        if (speculative_threads > 1 && compressed_size >= m_options.speculative_inflate_threshold) {
+            speculative_memory = inflater::SpeculativeInflater::working_set_size(m_image_data.size(), speculative_threads);
+            if (speculative_memory <= m_options.limits.max_memory - m_reserved_memory) {
+                reserve_memory(speculative_memory, "speculative inflate");
+            }
+            else {
+                speculative_threads = 0;
+            }
+        }
+        inflater.set_speculative_inflate(speculative_threads, m_options.speculative_inflate_threshold, speculative_memory);
+        inflater.inflate(data_chunks, m_image_data);
         // std::cout << "Inflated data size: " << m_image_data.size() << std::endl;
     }
 
+    std::vector <PNGDecoder::DataSegment> PNGDecoder::find_data_segments() const {
+        if (!m_options.parallel_inflate || m_header.interlace_method != 0 || m_header.width == 0) {
+            return {};
+        }
+
+        auto idot = std::find_if(m_chunks.begin(), m_chunks.end(), [](const Chunk& chunk) {
+            return chunk.get_tag() == chunk_tag::iDOT;
+        });
+        if (idot == m_chunks.end()) {
+            return {};
+        }
+
+        // iDOT layout, big-endian 32-bit words: segments count, reserved, rows of the first segment,
+        // offset of the first segment, height of each segment, offsets of the remaining segments;
+        // offsets are counted from the start of the iDOT chunk and point at IDAT chunks
+        const auto& idot_data = idot->get_data();
+        auto read_word = [&idot_data](size_t index) -> uint32_t {
+            uint32_t word;
+            std::memcpy(&word, idot_data.data() + index * sizeof(word), sizeof(word));
+            return utils::convert_from_big_endian_to_host(word);
+        };
+
+        if (idot_data.size() < 3 * sizeof(uint32_t)) {
+            return {};
+        }
+        uint32_t segments_count = read_word(0);
+        if (segments_count < 2 || idot_data.size() != (3 + 2 * static_cast<uint64_t>(segments_count)) * sizeof(uint32_t)) {
+            return {};
+        }
+
+        std::vector <DataSegment> segments(segments_count);
+        std::vector <uint64_t> positions(segments_count);
+        uint64_t total_height = 0;
+
+        for (uint32_t i = 0; i < segments_count; ++i) {
+            segments[i].first_row = static_cast<uint32_t>(total_height);
+            segments[i].height = read_word(4 + i);
+            total_height += segments[i].height;
+
+            uint32_t offset = (i == 0) ? read_word(3) : read_word(3 + segments_count + i);
+            positions[i] = idot->get_position() + offset;
+
+            if (segments[i].height == 0 || (i > 0 && positions[i] <= positions[i - 1])) {
+                return {};
+            }
+        }
+        if (total_height != m_header.height) {
+            return {};
+        }
+
+        // assign consecutive IDAT chunks to segments, each segment has to start exactly at a chunk
+        size_t segment_index = 0;
+        bool is_first_data_chunk = true;
+
+        for (const auto& chunk : m_chunks) {
+            if (chunk.get_type() != Chunk::ChunkType::DATA) {
+                continue;
+            }
+
+            if (is_first_data_chunk) {
+                if (chunk.get_position() != positions[0]) {
+                    return {};
+                }
+            }
+            else if (segment_index + 1 < segments_count && chunk.get_position() == positions[segment_index + 1]) {
+                ++segment_index;
+            }
+
+            is_first_data_chunk = false;
+            segments[segment_index].sources.emplace_back(chunk.get_data());
+        }
+
+        if (segment_index + 1 != segments_count) {
+            return {};
+        }
+
+        return segments;
+    }
+
+    bool PNGDecoder::inflate_and_defilter_segments(std::vector <IntermediateImage>& result) {
+        std::vector <DataSegment> segments = find_data_segments();
+        if (segments.empty()) {
+            return false;
+        }
+
+        uint32_t width = m_header.width;
+        m_image_data.resize(inflated_data_size());
+        // segments are inflated into their place in the image data and defiltered there
+        IntermediateImage image = get_intermediate_image(width, m_header.height, 0);
+
+        size_t workers = worker_count(segments.size());
+        auto& segment_inflaters = m_context.get_segment_inflaters(workers);
+
+        std::vector <inflater::SegmentInflater::Result> checksums(segments.size());
+        std::vector <std::promise<void>> defiltered(segments.size());
+        std::vector <std::shared_future<void>> defiltered_futures;
+        for (auto& promise : defiltered) {
+            defiltered_futures.push_back(promise.get_future().share());
+        }
+
+        auto process_segment = [&](size_t index, inflater::SegmentInflater& segment_inflater) {
+            const DataSegment& segment = segments[index];
+            uint64_t position = scanlines_size(width, segment.first_row);
+            std::span<uint8_t> dest(m_image_data.data() + position, scanlines_size(width, segment.height));
+
+            checksums[index] = segment_inflater.inflate(segment.sources, dest, index == 0, index + 1 == segments.size());
+
+            // up, average and paeth predict the first row from the last row of the previous segment
+            uint8_t first_filter_type = dest[0];
+            if (index > 0 && first_filter_type >= 2) {
+                defiltered_futures[index - 1].get();
+            }
+
+            defilter_rows(image, segment.first_row, segment.height, std::pmr::new_delete_resource());
+        };
+
+        // segments are taken in order, so the segment a worker waits for is always being processed by another one
+        std::atomic <size_t> next_segment = 0;
+        auto run_worker = [&](size_t worker) {
+            for (size_t index = next_segment++; index < segments.size(); index = next_segment++) {
+                try {
+                    process_segment(index, *segment_inflaters[worker]);
+                    defiltered[index].set_value();
+                }
+                catch (...) {
+                    defiltered[index].set_exception(std::current_exception());
+                }
+            }
+        };
+
+        std::vector <std::future<void>> threads;
+        for (size_t worker = 1; worker < workers; ++worker) {
+            threads.push_back(std::async(std::launch::async, run_worker, worker));
+        }
+        run_worker(0);
+        for (auto& thread : threads) {
+            thread.get();
+        }
+
+        try {
+            uint32_t checksum = checksums[0].checksum;
+            for (size_t i = 0; i < segments.size(); ++i) {
+                defiltered_futures[i].get();
+                if (i > 0) {
+                    checksum = inflater::SegmentInflater::combine_checksums(
+                        checksum,
+                        checksums[i].checksum,
+                        scanlines_size(width, segments[i].height)
+                    );
+                }
+            }
+
+            if (checksum != checksums.back().expected_stream_checksum) {
+                return false;
+            }
+        }
+        catch (const std::runtime_error&) {
+            // segments were not independent after all, the serial path decides whether the data is valid
+            return false;
+        }
+
+        result.clear();
+        result.push_back(std::move(image));
+        return true;
+    }
+
+    uint32_t PNGDecoder::worker_count(size_t tasks) const {
+        uint32_t threads = m_options.thread_count != 0 ? m_options.thread_count : std::thread::hardware_concurrency();
+        return static_cast<uint32_t>(std::clamp<size_t>(tasks, 1, std::max(1u, threads)));
+    }
+
+    uint64_t PNGDecoder::scanlines_size(uint32_t width, uint32_t height) const {
+        // empty passes of interlaced images have no scanlines and no filter bytes
+        if (width == 0 || height == 0) {
+            return 0;
+        }
+
+        uint64_t total_bits = static_cast<uint64_t>(width) * bits_per_pixel();
+        uint64_t length = (total_bits / 8) + (total_bits % 8 != 0);
+
+        // each scanline is preceded by the filter type byte
+        return (length + 1) * height;
+    }
+
+    uint64_t PNGDecoder::inflated_data_size() const {
+        if (m_header.interlace_method == 0) {
+            return scanlines_size(m_header.width, m_header.height);
+        }
+
+        uint64_t size = 0;
+        for (uint32_t pass = 1; pass <= 7; ++pass) {
+            uint32_t w;
+            uint32_t h;
+            set_subimage_size(pass, w, h);
+            size += scanlines_size(w, h);
+        }
+
+        return size;
+    }
+
 
     std::vector <PNGDecoder::IntermediateImage> PNGDecoder::defilter() {
         if (m_header.interlace_method == 0) {
             // std::cout << "No interlace defiltering method" << std::endl;
-            uint32_t pos = 0;
+            uint64_t pos = 0;
             IntermediateImage intermediate_image = defilter_non_interlaced(m_header.width, m_header.height, pos);
             // std::cout << intermediate_image.to_string() << std::endl;     
 
@@ -365,120 +969,112 @@ namespace png_decoder {
         throw error::unsupported_interlace_method("interlace_method = " + std::to_string(m_header.interlace_method));
     }
 
-    PNGDecoder::IntermediateImage PNGDecoder::defilter_non_interlaced(uint32_t width, uint32_t height, uint32_t& current_position) {
-        uint32_t bits = bits_per_pixel();
-        uint64_t total_bits = width * bits;
-        uint32_t bytes_per_pixel = std::max(1u, bits / 8); // bytes per pixel
-        
-        // scanline data length
-        uint32_t length = (total_bits / 8) + (total_bits % 8 != 0);
-
-        // std::cout << "scanline lengths are: " << length << std::endl;
+    PNGDecoder::IntermediateImage PNGDecoder::defilter_non_interlaced(uint32_t width, uint32_t height, uint64_t& current_position) {
+        IntermediateImage image = get_intermediate_image(width, height, current_position);
+        defilter_rows(image, 0, height, m_context.get_memory_resource());
+        current_position += scanlines_size(width, height);
 
-        Scanline previous_defiltered_scanline(0, length);
-        Scanline current_scanline(0, length);
-
-        IntermediateImage defiltered_data;
-        
-        defiltered_data.width = width;
-        defiltered_data.height = height;
+        // std::cout << "Current position at the end: " << current_position << std::endl; 
 
-        for (size_t scanlines_read = 0; scanlines_read < height; ++scanlines_read) {
-            // scanline filter_type
-            utils::read_data_as_host_endian(
-                m_image_data.data() + current_position,
-                &current_scanline.filter_type,
-                sizeof(current_scanline.filter_type),
-                "Cannot read scanline filter type at index " + std::to_string(current_position)
-            );
+        return image;
+    }
 
-            current_position += sizeof(current_scanline.filter_type);
+    PNGDecoder::IntermediateImage PNGDecoder::get_intermediate_image(uint32_t width, uint32_t height, uint64_t position) {
+        if (width == 0 || height == 0) {
+            // empty pass of an interlaced image, it has no scanlines at all
+            return IntermediateImage{ width, height, nullptr, 0 };
+        }
 
-            // scanline data
-            std::memcpy(
-                current_scanline.data.data(),
-                m_image_data.data() + current_position,
-                length
-            );
+        // the first row starts after its filter type byte
+        return IntermediateImage{ width, height, m_image_data.data() + position + 1, scanline_length(width) + 1ull };
+    }
 
-            current_position += length;
+    void PNGDecoder::defilter_rows(
+        IntermediateImage& image,
+        uint32_t first_row,
+        uint32_t row_count,
+        std::pmr::memory_resource* scratch
+    ) const {
+        if (row_count == 0) {
+            return;
+        }
 
-            // std::cout << "current scanline filter type is: " << static_cast<int> (current_scanline.filter_type) << std::endl;
+        uint32_t bits = bits_per_pixel();
+        uint32_t bytes_per_pixel = std::max(1u, bits / 8); // bytes per pixel
+        // kernels are looked up once, rows are dispatched by indexing the table with their filter type
+        const defilter_kernels::KernelTable& kernels = defilter_kernels::get_kernels(bytes_per_pixel);
+        
+        // scanline data length
+        uint32_t length = scanline_length(image.width);
 
-            // apply filters
-            auto defilter = Defilter::create_defilter(current_scanline.filter_type);
-            defilter->apply(current_scanline, previous_defiltered_scanline, bytes_per_pixel);
+        // rows are defiltered where they were inflated, the first row of an image predicts from zeros
+        std::pmr::vector <uint8_t> zero_row(first_row == 0 ? length : 0, 0, scratch);
+        const uint8_t* prior = first_row == 0 ? zero_row.data() : image.data + (first_row - 1) * image.stride;
 
-            defiltered_data.data.push_back(
-                std::vector<uint8_t>()
-            );
+        for (uint32_t row = first_row; row < first_row + row_count; ++row) {
+            uint8_t* current = image.data + row * image.stride;
+            // scanline filter_type
+            uint8_t filter_type = current[-1];
 
-            for (uint8_t byte : current_scanline.data) {
-                defiltered_data.data.back().push_back(byte);
+            if (filter_type >= kernels.size()) {
+                throw ::error::invalid_arguments("PNGDecoder::defilter_rows: invalid `filter_type`: " + std::to_string(filter_type) + " at row " + std::to_string(row));
             }
-            previous_defiltered_scanline = current_scanline;
-        }
 
-        // std::cout << "Current position at the end: " << current_position << std::endl; 
+            kernels[filter_type](current, prior, length);
+            prior = current;
+        }
+    }
 
-        return defiltered_data;
+    uint32_t PNGDecoder::scanline_length(uint32_t width) const {
+        uint64_t total_bits = static_cast<uint64_t>(width) * bits_per_pixel();
+        return (total_bits / 8) + (total_bits % 8 != 0);
     }
 
     std::vector <PNGDecoder::IntermediateImage> PNGDecoder::defilter_interlaced() {
         std::vector <IntermediateImage> result;
-        uint32_t position = 0;
-        
+        uint64_t position = 0;
         
         for (uint32_t pass = 1; pass <= 7; ++pass) {
             uint32_t w;
             uint32_t h;
             set_subimage_size(pass, w, h);
 
-            // std::cout << "Pass: " << pass << std::endl;
-            IntermediateImage img = defilter_non_interlaced(w, h, position);
-            // std::cout << img.to_string() << std::endl;
-            
-            result.push_back(img);
+            result.push_back(get_intermediate_image(w, h, position));
+            position += scanlines_size(w, h);
         }
 
-        return result;
-    }
+        // once inflated the passes are independent images, the largest ones (the last) are taken first
+        std::atomic <size_t> next_pass = 0;
+        auto run_worker = [&] {
+            for (size_t index = next_pass++; index < result.size(); index = next_pass++) {
+                IntermediateImage& image = result[result.size() - 1 - index];
+                defilter_rows(image, 0, image.height, std::pmr::new_delete_resource());
+            }
+        };
 
-    void PNGDecoder::set_subimage_size(uint32_t pass, uint32_t &w, uint32_t &h) {
-        uint32_t W = m_header.width;
-        uint32_t H = m_header.height;
-        
-        if (pass == 1) {
-            w = W / 8 + (W % 8 > 0);
-            h = H / 8 + (H % 8 > 0);
-        }
-        else if (pass == 2) {
-            w = W / 8 + (W % 8 > 4);
-            h = H / 8 + (H % 8 > 0);
-        }
-        else if (pass == 3) {
-            w = 2 * (W / 8) + (W % 8 > 0) + (W % 8 > 4);
-            h = H / 8 + (H % 8 > 4);
+        std::vector <std::future<void>> threads;
+        for (size_t worker = 1; worker < worker_count(result.size()); ++worker) {
+            threads.push_back(std::async(std::launch::async, run_worker));
         }
-        else if (pass == 4) {
-            w = 2 * (W / 8) + (W % 8 > 2) + (W % 8 > 6);
-            h = 2 * (H / 8) + (H % 8 > 0) + (H % 8 > 4);
+        run_worker();
+        for (auto& thread : threads) {
+            thread.get();
         }
-        else if (pass == 5) {
-            w = 4 * (W / 8) + (W % 8 > 0) + (W % 8 > 2) + (W % 8 > 4) + (W % 8 > 6);
-            h = 2 * (H / 8) + (H % 8 > 2) + (H % 8 > 6);
-        }
-        else if (pass == 6) {
-            w = 4 * (W / 8) + (W % 8 > 1) + (W % 8 > 3) + (W % 8 > 5);
-            h = 4 * (H / 8) + (H % 8 > 0) + (H % 8 > 2) + (H % 8 > 4) + (W % 8 > 6);
-        }
-        else if (pass == 7) {
-            w = 8 * (W / 8) + (W % 8);
-            h = 4 * (H / 8) + (H % 8 > 1) + (H % 8 > 3) + (H % 8 > 5);
-        }
-        else {
+
+        return result;
+    }
+
+    void PNGDecoder::set_subimage_size(uint32_t pass, uint32_t &w, uint32_t &h) const {
+        if (pass < 1 || pass > 7) {
             throw ::error::invalid_arguments("PNGDecoder::set_subimage_size `pass` must be in range [1, 7], but provided: " + std::to_string(pass));
         }
+
+        // pixels from the pass offset on, one per step
+        const Adam7Pass& adam7_pass = ADAM7_PASSES[pass - 1];
+        uint64_t W = m_header.width;
+        uint64_t H = m_header.height;
+        w = static_cast<uint32_t>(W > adam7_pass.x0 ? ((W - adam7_pass.x0 - 1) >> adam7_pass.x_shift) + 1 : 0);
+        h = static_cast<uint32_t>(H > adam7_pass.y0 ? ((H - adam7_pass.y0 - 1) >> adam7_pass.y_shift) + 1 : 0);
     }
 
     uint32_t PNGDecoder::bits_per_pixel() const {
@@ -506,88 +1102,343 @@ namespace png_decoder {
     }
 
 
-    Image PNGDecoder::create_image(std::vector <IntermediateImage>& parts) {
-        auto pixel_reader = PixelReader::create_pixel_reader(get_pixel_type(), m_header.bit_depth, m_pallete);
-        auto bits = bits_per_pixel();
-        
-        if (parts.size() == 1) {
-            Image result(m_header.height, m_header.width);
-            IntermediateImage& image = parts[0];
-
-            for (size_t h = 0; h < image.height; ++h) {
-                for (size_t w = 0; w < image.width; ++w) {
-                    std::optional <RGB> pixel = pixel_reader->get_pixel_at(
-                        image.data[h],
-                        w,
-                        bits
-                    );
+    template <class Pixel>
+    BasicImage<Pixel> PNGDecoder::create_image(std::vector <IntermediateImage>& parts) {
+        if (parts.size() != 1 && parts.size() != 7) {
+            throw ::error::invalid_arguments("parts size must either 1 or 7, but got " + std::to_string(parts.size()));
+        }
 
-                    if (pixel.has_value()) {
-                        result(h, w) = pixel.value();
-                    }
+        BasicImage<Pixel> result(m_header.height, m_header.width);
+        bool is_interlaced = parts.size() == 7;
+
+        // workers take bands of whole Adam7 tiles, so they never write the same image row
+        uint32_t tiles = m_header.height / 8 + (m_header.height % 8 != 0);
+        size_t workers = worker_count(tiles / CONVERT_BANDS_PER_WORKER);
+        uint64_t band_rows = 8ull * ((tiles + workers - 1) / workers);
+
+        auto convert_band = [&](size_t worker) {
+            auto pixel_reader = create_pixel_reader();
+            std::vector <Pixel> pass_pixels(is_interlaced ? m_header.width : 0);
+            uint64_t last_row = std::min<uint64_t>((worker + 1) * band_rows, m_header.height);
+
+            for (uint64_t row = worker * band_rows; row < last_row; ++row) {
+                if (is_interlaced) {
+                    store_interlaced_row<Pixel>(*pixel_reader, parts, static_cast<uint32_t>(row), pass_pixels, result);
+                }
+                else {
+                    store_row<Pixel>(*pixel_reader, parts[0].get_row(static_cast<uint32_t>(row)), parts[0].width, 0, static_cast<uint32_t>(row), result);
                 }
             }
+        };
+
+        std::vector <std::future<void>> threads;
+        for (size_t worker = 1; worker < workers; ++worker) {
+            threads.push_back(std::async(std::launch::async, convert_band, worker));
+        }
+        convert_band(0);
+        for (auto& thread : threads) {
+            thread.get();
+        }
+
+        return result;
+    }
+
+    template <class Pixel>
+    void PNGDecoder::store_row(PixelReader& pixel_reader, std::span<const uint8_t> row, uint32_t width, uint32_t pass, uint32_t row_index, BasicImage<Pixel>& image) {
+        if (pass == 0) {
+            pixel_reader.convert_row(row.data(), width, image.Row(row_index));
+            return;
+        }
+
+        const Adam7Pass& adam7_pass = ADAM7_PASSES[pass - 1];
+        Pixel* dest = image.Row(adam7_pass.y0 + (row_index << adam7_pass.y_shift)) + adam7_pass.x0;
+        uint32_t bits = bits_per_pixel();
+
+        // the pass row is converted in blocks on the stack, which are spread out with the pass step; blocks
+        // start at whole bytes as they hold a multiple of 8 pixels
+        std::array <Pixel, STORE_ROW_BLOCK_PIXELS> block;
+        for (size_t first = 0; first < width; first += block.size()) {
+            size_t count = std::min<size_t>(block.size(), width - first);
+            pixel_reader.convert_row(row.data() + first * bits / 8, count, block.data());
+
+            for (size_t i = 0; i < count; ++i) {
+                dest[(first + i) << adam7_pass.x_shift] = block[i];
+            }
+        }
+    }
 
-            return result;
+    template <class Pixel>
+    void PNGDecoder::store_interlaced_row(PixelReader& pixel_reader, const std::vector <IntermediateImage>& parts, uint32_t row, std::vector <Pixel>& pass_pixels, BasicImage<Pixel>& image) {
+        Pixel* dest = image.Row(row);
+        if (row % 2 == 1) {
+            // odd rows are whole rows of pass 7
+            pixel_reader.convert_row(parts[6].get_row(row / 2).data(), m_header.width, dest);
+            return;
         }
-        else if (parts.size() == 7) {
-            Image result(m_header.height, m_header.width);
 
-            for (int pass = 1; pass <= 7; ++pass) {
-                auto& image = parts[pass - 1];
+        // the rows of the passes with pixels in this image row split its columns, so they are converted one after
+        // another into `pass_pixels` (one pixel per column) and gathered from there, indexed by pass - 1
+        const auto& passes = ADAM7_TILE[row % 8];
+        std::array <const Pixel*, 7> pass_rows{};
+        Pixel* next = pass_pixels.data();
+        for (uint32_t column = 0; column < std::min(8u, m_header.width); ++column) {
+            uint32_t pass = passes[column];
+            if (pass_rows[pass - 1] != nullptr) {
+                continue;
+            }
 
-                for (size_t h = 0; h < image.height; ++h) {
-                    for (size_t w = 0; w < image.width; ++w) {
-                        std::optional <RGB> pixel = pixel_reader->get_pixel_at(image.data[h], w, bits);
+            const IntermediateImage& part = parts[pass - 1];
+            pixel_reader.convert_row(part.get_row(row >> ADAM7_PASSES[pass - 1].y_shift).data(), part.width, next);
+            pass_rows[pass - 1] = next;
+            next += part.width;
+        }
 
-                        if (pixel.has_value()) {
-                            size_t W;
-                            size_t H;
-                            set_image_pos_by_subimage(w, h, pass, W, H);
-                            result(H, W) = pixel.value();
-                        }
-                    }
-                }
+        for (uint32_t column = 0; column < m_header.width; ++column) {
+            uint32_t pass = passes[column % 8];
+            dest[column] = pass_rows[pass - 1][column >> ADAM7_PASSES[pass - 1].x_shift];
+        }
+    }
+
+    template <class Pixel>
+    BasicImage<Pixel> PNGDecoder::inflate_and_convert_rows() {
+        if (m_header.interlace_method > 1) {
+            throw error::unsupported_interlace_method("interlace_method = " + std::to_string(m_header.interlace_method));
+        }
+
+        auto& stream_inflater = m_context.get_stream_inflater();
+        stream_inflater.begin(get_data_chunks());
+
+        auto pixel_reader = create_pixel_reader();
+        uint32_t bytes_per_pixel = std::max(1u, bits_per_pixel() / 8);
+        const defilter_kernels::KernelTable& kernels = defilter_kernels::get_kernels(bytes_per_pixel);
+        BasicImage<Pixel> result(m_header.height, m_header.width);
+
+        // two rows with their filter type bytes, sized for the widest pass (the full image width)
+        size_t stride = scanline_length(m_header.width) + 1ull;
+        std::pmr::vector <uint8_t> rows(2 * stride, 0, m_context.get_memory_resource());
+        uint8_t* current = rows.data();
+        uint8_t* previous = rows.data() + stride;
+
+        bool is_interlaced = m_header.interlace_method == 1;
+        for (uint32_t pass = is_interlaced ? 1 : 0; pass <= (is_interlaced ? 7u : 0u); ++pass) {
+            uint32_t width;
+            uint32_t height;
+            set_pass_size(pass, width, height);
+            if (width == 0 || height == 0) {
+                // empty pass, it has no scanlines at all
+                continue;
             }
 
-            return result;
+            // the first row of each pass predicts from zeros
+            uint32_t length = scanline_length(width);
+            std::fill_n(previous + 1, length, 0);
+
+            for (uint32_t row = 0; row < height; ++row) {
+                stream_inflater.read({ current, length + 1ull });
+
+                uint8_t filter_type = current[0];
+                if (filter_type >= kernels.size()) {
+                    throw ::error::invalid_arguments("PNGDecoder::inflate_and_convert_rows: invalid `filter_type`: " + std::to_string(filter_type) + " at row " + std::to_string(row));
+                }
+                kernels[filter_type](current + 1, previous + 1, length);
+
+                store_row<Pixel>(*pixel_reader, { current + 1, length }, width, pass, row, result);
+                std::swap(current, previous);
+            }
         }
 
-        throw ::error::invalid_arguments("parts size must either 1 or 7, but got " + std::to_string(parts.size()));
+        stream_inflater.finish();
+        return result;
     }
 
-    void PNGDecoder::set_image_pos_by_subimage(size_t w, size_t h, int pass, size_t& W, size_t& H) {
-        if (pass == 1) {
-            W = 8 * w;
-            H = 8 * h;
+    template <class Pixel>
+    BasicImage<Pixel> PNGDecoder::inflate_and_convert_rows_pipelined() {
+        if (m_header.interlace_method > 1) {
+            throw error::unsupported_interlace_method("interlace_method = " + std::to_string(m_header.interlace_method));
         }
-        else if (pass == 2) {
-            W = 8 * w + 4;
-            H = 8 * h;
+
+        // consecutive rows of one pass with their filter type bytes, `stride` bytes apart in the batch buffer
+        struct Batch {
+            uint32_t pass;
+            uint32_t first_row;
+            uint32_t row_count;
+            uint32_t width;
+        };
+        // passed on instead of a buffer index after the last batch
+        const size_t END_OF_ROWS = std::numeric_limits<size_t>::max();
+
+        // the pipeline takes three threads at least, with fewer the stages run one after another on the calling thread
+        uint32_t threads = worker_count(std::numeric_limits<size_t>::max());
+        if (threads < 3) {
+            return inflate_and_convert_rows<Pixel>();
         }
-        else if (pass == 3) {
-            W = 4 * w;
-            H = 8 * h + 4;
+        size_t converters = threads - 2;
+        size_t stride = scanline_length(m_header.width) + 1ull;
+        size_t rows_per_batch = std::max<size_t>(1, PIPELINE_BATCH_SIZE / stride);
+        size_t batch_size = rows_per_batch * stride;
+        size_t buffer_count = converters * PIPELINE_BATCHES_PER_WORKER;
+
+        reserve_memory(static_cast<uint64_t>(buffer_count) * batch_size, "pipeline batches");
+        std::pmr::vector <uint8_t> buffers(buffer_count * batch_size, m_context.get_memory_resource());
+        std::vector <Batch> batches(buffer_count);
+
+        // every queue has one producer and one consumer: the k-th batch is converted by worker k % converters,
+        // which owns every converters-th buffer and hands it back to the inflate stage through its free queue
+        SpscRing <size_t> inflated(buffer_count + 1);
+        std::vector <std::unique_ptr<SpscRing<size_t>>> defiltered;
+        std::vector <std::unique_ptr<SpscRing<size_t>>> free_buffers;
+        for (size_t worker = 0; worker < converters; ++worker) {
+            defiltered.push_back(std::make_unique<SpscRing<size_t>>(PIPELINE_BATCHES_PER_WORKER + 1));
+            free_buffers.push_back(std::make_unique<SpscRing<size_t>>(PIPELINE_BATCHES_PER_WORKER));
         }
-        else if (pass == 4) {
-            W = 4 * w + 2;
-            H = 4 * h;
+        for (size_t buffer = 0; buffer < buffer_count; ++buffer) {
+            free_buffers[buffer % converters]->push(buffer);
         }
-        else if (pass == 5) {
-            W = 2 * w;
-            H = 4 * h + 2;
+
+        // a failing stage aborts all queues, so the others stop waiting and return
+        std::vector <std::exception_ptr> errors(2 + converters);
+        auto run_stage = [&](size_t stage, auto&& body) {
+            try {
+                body();
+            }
+            catch (...) {
+                errors[stage] = std::current_exception();
+                inflated.abort();
+                for (size_t worker = 0; worker < converters; ++worker) {
+                    defiltered[worker]->abort();
+                    free_buffers[worker]->abort();
+                }
+            }
+        };
+
+        bool is_interlaced = m_header.interlace_method == 1;
+        auto inflate_rows = [&] {
+            auto& stream_inflater = m_context.get_stream_inflater();
+            stream_inflater.begin(get_data_chunks());
+
+            size_t sequence = 0;
+            for (uint32_t pass = is_interlaced ? 1 : 0; pass <= (is_interlaced ? 7u : 0u); ++pass) {
+                uint32_t width;
+                uint32_t height;
+                set_pass_size(pass, width, height);
+                if (width == 0 || height == 0) {
+                    continue;
+                }
+
+                uint32_t length = scanline_length(width);
+                for (uint32_t first_row = 0; first_row < height; first_row += rows_per_batch, ++sequence) {
+                    size_t buffer;
+                    if (!free_buffers[sequence % converters]->pop(buffer)) {
+                        return;
+                    }
+
+                    uint32_t row_count = static_cast<uint32_t>(std::min<size_t>(rows_per_batch, height - first_row));
+                    uint8_t* data = buffers.data() + buffer * batch_size;
+                    for (uint32_t row = 0; row < row_count; ++row) {
+                        stream_inflater.read({ data + row * stride, length + 1ull });
+                    }
+
+                    batches[buffer] = Batch{ pass, first_row, row_count, width };
+                    if (!inflated.push(buffer)) {
+                        return;
+                    }
+                }
+            }
+
+            stream_inflater.finish();
+            inflated.push(END_OF_ROWS);
+        };
+
+        // the only stage which is serial row to row
+        auto defilter_batches = [&] {
+            uint32_t bytes_per_pixel = std::max(1u, bits_per_pixel() / 8);
+            const defilter_kernels::KernelTable& kernels = defilter_kernels::get_kernels(bytes_per_pixel);
+            // the last row of a batch, its buffer moves on to the conversion
+            std::vector <uint8_t> previous_row(stride);
+
+            size_t sequence = 0;
+            size_t buffer;
+            while (inflated.pop(buffer)) {
+                if (buffer == END_OF_ROWS) {
+                    for (auto& queue : defiltered) {
+                        queue->push(END_OF_ROWS);
+                    }
+                    return;
+                }
+
+                const Batch& batch = batches[buffer];
+                uint32_t length = scanline_length(batch.width);
+                if (batch.first_row == 0) {
+                    // the first row of each pass predicts from zeros
+                    std::fill_n(previous_row.begin(), length, 0);
+                }
+
+                uint8_t* data = buffers.data() + buffer * batch_size;
+                const uint8_t* prior = previous_row.data();
+                for (uint32_t row = 0; row < batch.row_count; ++row) {
+                    uint8_t* current = data + row * stride;
+                    uint8_t filter_type = current[0];
+                    if (filter_type >= kernels.size()) {
+                        throw ::error::invalid_arguments("PNGDecoder::inflate_and_convert_rows_pipelined: invalid `filter_type`: " + std::to_string(filter_type) + " at row " + std::to_string(batch.first_row + row));
+                    }
+                    kernels[filter_type](current + 1, prior, length);
+                    prior = current + 1;
+                }
+                std::memcpy(previous_row.data(), prior, length);
+
+                if (!defiltered[sequence++ % converters]->push(buffer)) {
+                    return;
+                }
+            }
+        };
+
+        BasicImage<Pixel> result(m_header.height, m_header.width);
+        // workers store disjoint rows (or disjoint Adam7 pixels) of the image
+        auto convert_batches = [&](size_t worker) {
+            auto pixel_reader = create_pixel_reader();
+
+            size_t buffer;
+            while (defiltered[worker]->pop(buffer) && buffer != END_OF_ROWS) {
+                const Batch& batch = batches[buffer];
+                uint32_t length = scanline_length(batch.width);
+                const uint8_t* data = buffers.data() + buffer * batch_size;
+                for (uint32_t row = 0; row < batch.row_count; ++row) {
+                    store_row<Pixel>(*pixel_reader, { data + row * stride + 1, length }, batch.width, batch.pass, batch.first_row + row, result);
+                }
+
+                if (!free_buffers[worker]->push(buffer)) {
+                    return;
+                }
+            }
+        };
+
+        std::vector <std::future<void>> stages;
+        stages.push_back(std::async(std::launch::async, [&] { run_stage(1, defilter_batches); }));
+        for (size_t worker = 0; worker < converters; ++worker) {
+            stages.push_back(std::async(std::launch::async, [&, worker] { run_stage(2 + worker, [&] { convert_batches(worker); }); }));
         }
-        else if (pass == 6) {
-            W = 2 * w + 1;
-            H = 2 * h;
+        run_stage(0, inflate_rows);
+        for (auto& stage : stages) {
+            stage.get();
         }
-        else if (pass == 7) {
-            W = w;
-            H = 2 * h + 1;
+
+        // the earliest stage failing is the cause, the later ones fail on its garbage at most
+        for (auto& error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
         }
-        else {
-            throw ::error::invalid_arguments("PNGDecoder::set_image_pos_by_subimage `pass` must be in range [1, 7], but provided: " + std::to_string(pass));
+
+        return result;
+    }
+
+    void PNGDecoder::set_pass_size(uint32_t pass, uint32_t& w, uint32_t& h) const {
+        if (pass == 0) {
+            w = m_header.width;
+            h = m_header.height;
+            return;
         }
+        set_subimage_size(pass, w, h);
     }
 
     PixelReader::PixelType PNGDecoder::get_pixel_type() const {
@@ -611,6 +1462,10 @@ namespace png_decoder {
         }
     }
 
+    std::unique_ptr<PixelReader> PNGDecoder::create_pixel_reader() const {
+        return PixelReader::create_pixel_reader(get_pixel_type(), m_header.bit_depth, m_pallete, m_output_layout.format);
+    }
+
     std::string PNGDecoder::Header::to_string() const {
         std::stringstream ss;
         ss << "======== PNG Header ========"   << std::endl
@@ -640,13 +1495,37 @@ namespace png_decoder {
         return color_type == 3;
     }
 
+    std::span<const uint8_t> PNGDecoder::IntermediateImage::get_row(uint32_t row) const noexcept {
+        return { data + row * stride, stride - 1 };
+    }
+
     std::string PNGDecoder::IntermediateImage::to_string() const {
         std::stringstream ss;
-        ss << "IntermediateImage: (w: " << width << ", h: " << height << "), data length: " << data.size() << std::endl;
+        ss << "IntermediateImage: (w: " << width << ", h: " << height << "), stride: " << stride << std::endl;
 
         return ss.str();
     }
-}
-
 
+    template Gray8Image PNGDecoder::decode<Gray8>();
+    template GrayA8Image PNGDecoder::decode<GrayA8>();
+    template RGB8Image PNGDecoder::decode<RGB8>();
+    template Image PNGDecoder::decode<RGBA8>();
+    template RGBA16Image PNGDecoder::decode<RGBA16>();
+}
 
+// the free functions for every pixel format
+#define INSTANTIATE_DECODE_FUNCTIONS(Pixel) \
+    template BasicImage<Pixel> ReadPng<Pixel>(std::string_view, const png_decoder::DecoderOptions&); \
+    template BasicImage<Pixel> ReadPng<Pixel>(std::string_view, png_decoder::DecoderContext&, const png_decoder::DecoderOptions&); \
+    template BasicImage<Pixel> ReadPngMapped<Pixel>(std::string_view, const png_decoder::DecoderOptions&); \
+    template BasicImage<Pixel> ReadPngMapped<Pixel>(std::string_view, png_decoder::DecoderContext&, const png_decoder::DecoderOptions&); \
+    template BasicImage<Pixel> DecodePng<Pixel>(std::span<const uint8_t>, const png_decoder::DecoderOptions&); \
+    template BasicImage<Pixel> DecodePng<Pixel>(std::span<const uint8_t>, png_decoder::DecoderContext&, const png_decoder::DecoderOptions&);
+
+INSTANTIATE_DECODE_FUNCTIONS(Gray8)
+INSTANTIATE_DECODE_FUNCTIONS(GrayA8)
+INSTANTIATE_DECODE_FUNCTIONS(RGB8)
+INSTANTIATE_DECODE_FUNCTIONS(RGBA8)
+INSTANTIATE_DECODE_FUNCTIONS(RGBA16)
+
+#undef INSTANTIATE_DECODE_FUNCTIONS
@@ -6,33 +6,75 @@
 #include <vector>
 #include <optional>
 #include <sstream>
+#include <span>
+#include <memory_resource>
+#include <array>
+#include <utility>
 
 // custom includes
 #include "chunk.h"
+#include "crc_verifier.h"
+#include "decoder_context.h"
+#include "decoder_options.h"
 #include "pallete.h"
+#include "png_info.h"
 #include "pixel_reader.h"
+#include "spsc_ring.h"
 #include "../../image.h"
+#include "../errors.h"
 #include "../utils.h"
 
-Image ReadPng(std::string_view filename);
+// the free functions and `PNGDecoder::decode` write pixels of any format of image.h, RGBA8 unless asked otherwise
+template <class Pixel = RGBA8>
+BasicImage<Pixel> ReadPng(std::string_view filename, const png_decoder::DecoderOptions& options = {});
+// decodes reusing the inflater and scratch buffers of `context`
+template <class Pixel = RGBA8>
+BasicImage<Pixel> ReadPng(std::string_view filename, png_decoder::DecoderContext& context, const png_decoder::DecoderOptions& options = {});
+// decodes a memory mapping of the file, chunk data (IDAT included) is read in place from the page cache
+template <class Pixel = RGBA8>
+BasicImage<Pixel> ReadPngMapped(std::string_view filename, const png_decoder::DecoderOptions& options = {});
+template <class Pixel = RGBA8>
+BasicImage<Pixel> ReadPngMapped(std::string_view filename, png_decoder::DecoderContext& context, const png_decoder::DecoderOptions& options = {});
+// decodes a PNG file held in memory, chunks are parsed in place without copying the blob
+template <class Pixel = RGBA8>
+BasicImage<Pixel> DecodePng(std::span<const uint8_t> data, const png_decoder::DecoderOptions& options = {});
+template <class Pixel = RGBA8>
+BasicImage<Pixel> DecodePng(std::span<const uint8_t> data, png_decoder::DecoderContext& context, const png_decoder::DecoderOptions& options = {});
 
 namespace png_decoder {
 
     class PNGDecoder {
     public:
-        PNGDecoder(std::istream& stream);
-
-        Image decode();
+        PNGDecoder(std::istream& stream, DecoderOptions options = {});
+        PNGDecoder(std::istream& stream, DecoderContext& context, DecoderOptions options = {});
+        // decodes the bytes of a whole PNG file in place, chunks are views into `data`, which must outlive `decode`
+        PNGDecoder(std::span<const uint8_t> data, DecoderOptions options = {});
+        PNGDecoder(std::span<const uint8_t> data, DecoderContext& context, DecoderOptions options = {});
+
+        // samples are converted straight into `Pixel`: 16-bit samples keep all their bits in RGBA16 and the gray
+        // formats hold the luma of color images (see `FromRGBA16`); instantiated for the formats of image.h
+        template <class Pixel = RGBA8>
+        BasicImage<Pixel> decode();
     
     private:
+        // (sub)image defiltered in place in the inflated data: rows are `stride` bytes apart, each one follows
+        // its filter type byte; `data` points at the first row and is null for empty passes
         struct IntermediateImage {
             uint32_t width;
             uint32_t height;
-            // std::vector <uint8_t> data;
-            std::vector <std::vector<uint8_t>> data;
+            uint8_t* data;
+            size_t stride;
 
+            std::span<const uint8_t> get_row(uint32_t row) const noexcept;
             std::string to_string() const;
         };
+        // part of the image data compressed independently of the previous ones, announced by an Apple iDOT chunk;
+        // starts at a row boundary and at the start of an IDAT chunk
+        struct DataSegment {
+            uint32_t first_row;
+            uint32_t height;
+            std::vector <std::span<const uint8_t>> sources;
+        };
         struct Header {
             uint32_t width;
             uint32_t height;
@@ -56,38 +98,151 @@ namespace png_decoder {
         void validate_png_signature_valid(uint64_t signature) const;
         
         void read_all_chunks();
+        // reads the next chunk and checks its crc, throws `error::invalid_crc_checksum` on mismatch;
+        // the check of IDAT chunks is left to `start_data_crc_verification` when `m_is_data_crc_deferred` is set
         std::optional<Chunk> read_chunk();
+        std::optional<Chunk> read_chunk_from_stream();
+        std::optional<Chunk> read_chunk_from_memory();
+        // bytes left after the current position of `m_stream`, none when the stream cannot seek
+        std::optional<uint64_t> get_remaining_stream_size() const;
+        // whether the chunk is kept in `m_chunks`, see `DecoderOptions::retained_chunks`
+        bool is_chunk_retained(ChunkTag tag) const noexcept;
+        bool is_chunk_crc_checked(ChunkTag tag) const noexcept;
         void validate_chunks();
-        void validate_chunks_crc_checksum();
+        // verifies the deferred IDAT crcs, on worker threads when the image data is large enough
+        void start_data_crc_verification(std::optional<CrcVerifier>& verifier);
+        void finish_data_crc_verification(std::optional<CrcVerifier>& verifier);
+        static error::invalid_crc_checksum crc_mismatch_error(const Chunk& chunk, size_t chunk_number, uint32_t checksum);
+        // throws the mismatch of a chunk checked while reading; after the first IDAT with deferred IDAT checks it is
+        // kept in `m_late_crc_mismatch` instead, as an earlier IDAT may be bad as well
+        void report_crc_mismatch(const Chunk& chunk, size_t chunk_number, uint32_t checksum);
 
         void read_header();
         void validate_header();
+        // checks the header against `DecoderOptions::limits` and reserves the memory the image will take
+        void validate_limits();
+        // accounts `bytes` against the memory budget, throws `error::limit_exceeded` when it would be exceeded
+        void reserve_memory(uint64_t bytes, const char* purpose);
 
         void read_pallete();
         void validate_pallete();
 
+        // views over the data of the IDAT chunks in order
+        std::vector <std::span<const uint8_t>> get_data_chunks() const;
         void inflate_data_chunks();
+        // segments listed by an iDOT chunk, empty when there is none or it does not match the IDAT layout
+        std::vector <DataSegment> find_data_segments() const;
+        // inflates and defilters the segments on worker threads; returns false when the image has no segments
+        // or they cannot be decoded independently, the serial path is taken then
+        bool inflate_and_defilter_segments(std::vector <IntermediateImage>& result);
+        uint32_t worker_count(size_t tasks) const;
+        // size of the filtered scanlines (with filter type bytes) of a `width` x `height` (sub)image
+        uint64_t scanlines_size(uint32_t width, uint32_t height) const;
+        // exact size of the inflated image data, summed over Adam7 passes for interlaced images
+        uint64_t inflated_data_size() const;
 
         std::vector <IntermediateImage> defilter();
-        IntermediateImage defilter_non_interlaced(uint32_t width, uint32_t height, uint32_t& current_position);
+        IntermediateImage defilter_non_interlaced(uint32_t width, uint32_t height, uint64_t& current_position);
+        // view of the `width` x `height` scanlines starting at `position` of the inflated data
+        IntermediateImage get_intermediate_image(uint32_t width, uint32_t height, uint64_t position);
+        // defilters `row_count` rows from `first_row` on in place, the row before `first_row` must be defiltered
+        // already; `scratch` backs the zero row the first image row predicts from
+        void defilter_rows(IntermediateImage& image, uint32_t first_row, uint32_t row_count, std::pmr::memory_resource* scratch) const;
+        // length of a scanline without the filter type byte
+        uint32_t scanline_length(uint32_t width) const;
         std::vector <IntermediateImage> defilter_interlaced();
 
         uint32_t bits_per_pixel() const;
-        void set_subimage_size(uint32_t pass, uint32_t &w, uint32_t &h);
-        void set_image_pos_by_subimage(size_t w, size_t h, int pass, size_t& W, size_t& H);
-
-        Image create_image(std::vector <IntermediateImage>& parts);
+        void set_subimage_size(uint32_t pass, uint32_t &w, uint32_t &h) const;
+
+        // converts bands of whole Adam7 tiles (8 rows) on worker threads, row by row of the image
+        template <class Pixel>
+        BasicImage<Pixel> create_image(std::vector <IntermediateImage>& parts);
+        // converts the defiltered `row_index`-th row of Adam7 pass `pass` (0 for images without interlace) into pixels of `image`
+        template <class Pixel>
+        void store_row(PixelReader& pixel_reader, std::span<const uint8_t> row, uint32_t width, uint32_t pass, uint32_t row_index, BasicImage<Pixel>& image);
+        // gathers image row `row` of an interlaced image from the rows of the passes in `parts`, left to right,
+        // so each cache line of the image row is written once; `pass_pixels` holds a row of the image width
+        template <class Pixel>
+        void store_interlaced_row(PixelReader& pixel_reader, const std::vector <IntermediateImage>& parts, uint32_t row, std::vector <Pixel>& pass_pixels, BasicImage<Pixel>& image);
+        // `DecoderOptions::fused_rows`: each scanline is inflated into one of two row buffers, defiltered against
+        // the other one and stored into the image right away
+        template <class Pixel>
+        BasicImage<Pixel> inflate_and_convert_rows();
+        // `DecoderOptions::pipelined_rows`: the stages of `inflate_and_convert_rows` on separate threads
+        template <class Pixel>
+        BasicImage<Pixel> inflate_and_convert_rows_pipelined();
+        // size of Adam7 pass `pass`, the whole image for pass 0 of images without interlace
+        void set_pass_size(uint32_t pass, uint32_t& w, uint32_t& h) const;
         PixelReader::PixelType get_pixel_type() const;
+        std::unique_ptr<PixelReader> create_pixel_reader() const;
 
 
     private:
         const inline static uint64_t PNG_SIGNATURE_VALUE = utils::convert_from_big_endian_to_host((uint64_t) (0x0a1a0a0d474e5089));
+        const inline static uint32_t HEADER_LENGTH = 13;
+        // chunk data is read and checksummed in blocks of this size
+        const inline static size_t CHUNK_READ_BLOCK_SIZE = 64 * 1024;
+        // chunks which are not retained are checksummed through a stack buffer of this size
+        const inline static size_t SKIPPED_CHUNK_BUFFER_SIZE = 4 * 1024;
+        // rows are handed between pipeline stages in batches of about this size
+        const inline static size_t PIPELINE_BATCH_SIZE = 64 * 1024;
+        // batches in flight per conversion worker
+        const inline static size_t PIPELINE_BATCHES_PER_WORKER = 4;
+        // fewer 8-row bands than this per worker are converted on fewer workers
+        const inline static size_t CONVERT_BANDS_PER_WORKER = 8;
+        // Adam7 pass rows are converted through a stack block of this many pixels (a multiple of 8)
+        const inline static size_t STORE_ROW_BLOCK_PIXELS = 64;
+
+        // Adam7 pass p holds the pixels (x0 + i * 2^x_shift, y0 + j * 2^y_shift), passes 1 - 7 at indices 0 - 6;
+        // x0 and y0 are less than the steps, so image column x is column x >> x_shift of its pass (rows alike)
+        struct Adam7Pass {
+            uint32_t x0;
+            uint32_t y0;
+            uint32_t x_shift;
+            uint32_t y_shift;
+        };
+        constexpr inline static std::array<Adam7Pass, 7> ADAM7_PASSES = {{
+            { 0, 0, 3, 3 }, { 4, 0, 3, 3 }, { 0, 4, 2, 3 }, { 2, 0, 2, 2 }, { 0, 2, 1, 2 }, { 1, 0, 1, 1 }, { 0, 1, 0, 1 }
+        }};
+        // pass of each pixel of an 8x8 Adam7 tile
+        constexpr inline static std::array<std::array<uint8_t, 8>, 8> ADAM7_TILE = {{
+            { 1, 6, 4, 6, 2, 6, 4, 6 },
+            { 7, 7, 7, 7, 7, 7, 7, 7 },
+            { 5, 6, 5, 6, 5, 6, 5, 6 },
+            { 7, 7, 7, 7, 7, 7, 7, 7 },
+            { 3, 6, 4, 6, 3, 6, 4, 6 },
+            { 7, 7, 7, 7, 7, 7, 7, 7 },
+            { 5, 6, 5, 6, 5, 6, 5, 6 },
+            { 7, 7, 7, 7, 7, 7, 7, 7 }
+        }};
     
-        std::istream& m_stream;
-        std::vector <Chunk> m_chunks;
-        std::vector <uint8_t> m_image_data;
+        // input is either a stream or a memory block, `m_stream` is null for the latter
+        std::istream* m_stream;
+        std::span<const uint8_t> m_input;
+        // offset of the next chunk from the start of the input
+        size_t m_input_position;
+        DecoderOptions m_options;
+        // owned only when no external context is provided
+        std::unique_ptr<DecoderContext> m_own_context;
+        DecoderContext& m_context;
+        std::pmr::vector <Chunk>& m_chunks;
+        std::pmr::vector <uint8_t>& m_image_data;
         Header m_header;
         Pallete m_pallete;
+        bool m_is_data_crc_deferred;
+        bool m_is_data_chunk_read;
+        // chunks read from the input so far, retained or not, and the number in the input of each of `m_chunks`;
+        // crc errors report these numbers
+        size_t m_input_chunk_count;
+        std::vector <size_t> m_chunk_numbers;
+        // first mismatch reported after the first IDAT, thrown by `finish_data_crc_verification` unless a deferred
+        // IDAT check fails on a lower-numbered chunk
+        std::optional<std::pair<size_t, error::invalid_crc_checksum>> m_late_crc_mismatch;
+        // layout of the pixels `decode` writes, the image memory is accounted with it
+        PixelLayout m_output_layout;
+        // memory accounted against `DecodeLimits::max_memory` so far
+        uint64_t m_reserved_memory;
     };
 
 } // namesapce png_decoder
\ No newline at end of file
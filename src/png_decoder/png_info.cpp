@@ -0,0 +1,223 @@
+#include "png_info.h"
+
+// stl includes
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+
+// custom includes
+#include "../errors.h"
+#include "../utils.h"
+#include "../crc_calculator/crc_calculator.h"
+#include "chunk.h"
+
+namespace png_decoder {
+
+    namespace {
+        const uint8_t PNG_SIGNATURE[8] = { 0x89, 'P', 'N', 'G', 0x0d, 0x0a, 0x1a, 0x0a };
+        const uint32_t HEADER_LENGTH = 13;
+        const uint32_t PHYSICAL_DIMENSIONS_LENGTH = 9;
+        // chunk data is read in blocks of this size, so a length field promising more than the input holds
+        // does not allocate it up front
+        const size_t READ_BLOCK_SIZE = 64 * 1024;
+
+        // input read front to back, uninteresting chunks are skipped with a seek where the stream allows it
+        class StreamSource {
+        public:
+            explicit StreamSource(std::istream& stream) : m_stream(stream) {}
+
+            // returns false when the input ended before the first byte, throws when it ended after it
+            bool try_read(void* dest, size_t size) {
+                bool is_read = utils::read_as_host_endian(m_stream, static_cast<char*>(dest), size, [] {
+                    return "Cannot read from stream";
+                });
+                if (!is_read && m_stream.gcount() != 0) {
+                    throw error::unable_to_read_from_stream("Unexpected end of stream");
+                }
+                return is_read;
+            }
+
+            void read(void* dest, size_t size) {
+                if (!try_read(dest, size)) {
+                    throw error::unable_to_read_from_stream("Unexpected end of stream");
+                }
+            }
+
+            void skip(uint64_t size) {
+                if (m_stream.seekg(static_cast<std::streamoff>(size), std::ios_base::cur)) {
+                    return;
+                }
+
+                // streams which cannot seek are read through
+                m_stream.clear();
+                m_stream.ignore(static_cast<std::streamsize>(size));
+                if (static_cast<uint64_t>(m_stream.gcount()) != size) {
+                    throw error::unable_to_read_from_stream("Cannot skip chunk");
+                }
+            }
+
+        private:
+            std::istream& m_stream;
+        };
+
+        class MemorySource {
+        public:
+            explicit MemorySource(std::span<const uint8_t> data) : m_data(data), m_position(0) {}
+
+            bool try_read(void* dest, size_t size) {
+                if (m_position == m_data.size()) {
+                    return false;
+                }
+                read(dest, size);
+                return true;
+            }
+
+            void read(void* dest, size_t size) {
+                if (m_data.size() - m_position < size) {
+                    throw error::unable_to_read_from_source("Cannot read at pos " + std::to_string(m_position));
+                }
+                std::memcpy(dest, m_data.data() + m_position, size);
+                m_position += size;
+            }
+
+            void skip(uint64_t size) {
+                if (m_data.size() - m_position < size) {
+                    throw error::unable_to_read_from_source("Cannot skip chunk at pos " + std::to_string(m_position));
+                }
+                m_position += static_cast<size_t>(size);
+            }
+
+        private:
+            std::span<const uint8_t> m_data;
+            size_t m_position;
+        };
+
+        uint32_t read_big_endian(const uint8_t* bytes) {
+            uint32_t value;
+            std::memcpy(&value, bytes, sizeof(value));
+            return utils::convert_from_big_endian_to_host(value);
+        }
+
+        template <class Source>
+        std::vector<uint8_t> read_chunk_data(Source& source, ChunkTag tag, uint32_t length, const PngInfoOptions& options) {
+            if (length > options.max_chunk_size) {
+                throw error::limit_exceeded("Chunk " + get_chunk_tag_label(tag) + " is " + std::to_string(length) + " bytes long");
+            }
+
+            // the length comes from the file, the buffer only grows with the data actually read
+            std::vector<uint8_t> data;
+            for (size_t offset = 0; offset < length; offset += READ_BLOCK_SIZE) {
+                size_t block_size = std::min<size_t>(READ_BLOCK_SIZE, length - offset);
+                data.resize(offset + block_size);
+                source.read(data.data() + offset, block_size);
+            }
+
+            uint8_t crc_bytes[4];
+            source.read(crc_bytes, sizeof(crc_bytes));
+
+            if (options.verify_crc) {
+                auto tag_bytes = get_chunk_tag_bytes(tag);
+                uint32_t checksum = crc_calculator::update_crc32_checksum(0, tag_bytes.data(), tag_bytes.size());
+                checksum = crc_calculator::update_crc32_checksum(checksum, data.data(), data.size());
+                if (checksum != read_big_endian(crc_bytes)) {
+                    throw error::invalid_crc_checksum("Checksum: " + std::to_string(checksum) + ", chunk " + get_chunk_tag_label(tag));
+                }
+            }
+
+            return data;
+        }
+
+        template <class Source>
+        PngInfo read_info(Source& source, const PngInfoOptions& options) {
+            uint8_t signature[sizeof(PNG_SIGNATURE)];
+            if (!source.try_read(signature, sizeof(signature)) || std::memcmp(signature, PNG_SIGNATURE, sizeof(signature)) != 0) {
+                throw error::invalid_png_signature();
+            }
+
+            PngInfo info{};
+            bool is_header_read = false;
+
+            while (true) {
+                uint8_t fields[8];
+                if (!source.try_read(fields, sizeof(fields))) {
+                    break;
+                }
+
+                uint32_t length = read_big_endian(fields);
+                ChunkTag tag = read_chunk_tag(fields + 4);
+
+                if (!is_header_read) {
+                    if (tag != chunk_tag::IHDR) {
+                        throw error::invalid_header_chunk("Header chunk must come first");
+                    }
+                    if (length != HEADER_LENGTH) {
+                        throw error::invalid_header_chunk("Header chunk must be " + std::to_string(HEADER_LENGTH) + " bytes long");
+                    }
+
+                    auto data = read_chunk_data(source, tag, length, options);
+                    info.width = read_big_endian(data.data());
+                    info.height = read_big_endian(data.data() + 4);
+                    info.bit_depth = data[8];
+                    info.color_type = data[9];
+                    info.interlace_method = data[12];
+                    is_header_read = true;
+
+                    if (!options.read_metadata) {
+                        break;
+                    }
+                }
+                else if (tag == chunk_tag::IEND || (tag == chunk_tag::IDAT && !options.read_trailing_metadata)) {
+                    break;
+                }
+                else if (tag == chunk_tag::pHYs && length == PHYSICAL_DIMENSIONS_LENGTH) {
+                    auto data = read_chunk_data(source, tag, length, options);
+                    info.physical_dimensions = PhysicalDimensions{ read_big_endian(data.data()), read_big_endian(data.data() + 4), data[8] };
+                }
+                else if (tag == chunk_tag::tEXt) {
+                    auto data = read_chunk_data(source, tag, length, options);
+                    auto separator = std::find(data.begin(), data.end(), 0);
+                    TextEntry entry;
+                    entry.keyword.assign(data.begin(), separator);
+                    if (separator != data.end()) {
+                        entry.text.assign(separator + 1, data.end());
+                    }
+                    info.text.push_back(std::move(entry));
+                }
+                else {
+                    // the data of everything else, IDAT included, is never read; the crc is, so a file cut short
+                    // inside a skipped chunk is noticed
+                    uint8_t crc_bytes[4];
+                    source.skip(length);
+                    source.read(crc_bytes, sizeof(crc_bytes));
+                }
+            }
+
+            if (!is_header_read) {
+                throw error::invalid_header_chunk("Header chunk must come first");
+            }
+
+            return info;
+        }
+    }
+
+} // namespace png_decoder
+
+png_decoder::PngInfo ReadPngInfo(std::string_view filename, const png_decoder::PngInfoOptions& options) {
+    std::ifstream input_stream(filename.data(), std::ios_base::binary | std::ios_base::in);
+
+    if (!input_stream || !input_stream.is_open()) {
+        throw error::unable_to_open_file(std::string(filename));
+    }
+
+    return ReadPngInfo(input_stream, options);
+}
+
+png_decoder::PngInfo ReadPngInfo(std::istream& stream, const png_decoder::PngInfoOptions& options) {
+    png_decoder::StreamSource source(stream);
+    return png_decoder::read_info(source, options);
+}
+
+png_decoder::PngInfo ReadPngInfo(std::span<const uint8_t> data, const png_decoder::PngInfoOptions& options) {
+    png_decoder::MemorySource source(data);
+    return png_decoder::read_info(source, options);
+}
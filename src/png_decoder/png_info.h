@@ -0,0 +1,57 @@
+#pragma once
+
+// stl includes
+#include <string>
+#include <string_view>
+#include <vector>
+#include <optional>
+#include <span>
+#include <istream>
+#include <cstdint>
+
+// custom includes
+
+namespace png_decoder {
+
+    // physical pixel dimensions (pHYs)
+    struct PhysicalDimensions {
+        uint32_t pixels_per_unit_x;
+        uint32_t pixels_per_unit_y;
+        uint8_t unit; // 0 - aspect ratio only, 1 - metre
+    };
+
+    // keyword and text of a tEXt chunk
+    struct TextEntry {
+        std::string keyword;
+        std::string text;
+    };
+
+    // image properties collected without touching the image data
+    struct PngInfo {
+        uint32_t width;
+        uint32_t height;
+        uint8_t bit_depth;
+        uint8_t color_type;
+        uint8_t interlace_method;
+        std::optional<PhysicalDimensions> physical_dimensions;
+        std::vector<TextEntry> text;
+    };
+
+    struct PngInfoOptions {
+        // collect pHYs and tEXt chunks up to the first IDAT, otherwise reading stops right after IHDR
+        bool read_metadata = false;
+        // keep collecting past the image data (tEXt may follow IDAT), data chunks are skipped with a seek, or read
+        // through and dropped on streams which cannot seek
+        bool read_trailing_metadata = false;
+        // check the crc of the chunks which are read, skipped chunks are never checked
+        bool verify_crc = true;
+        // chunks which are read (IHDR, pHYs, tEXt) may not be longer, `error::limit_exceeded` is thrown otherwise
+        uint32_t max_chunk_size = 1u << 24;
+    };
+
+} // namespace png_decoder
+
+// reads the header and optionally some ancillary chunks; the cost does not depend on the image size
+png_decoder::PngInfo ReadPngInfo(std::string_view filename, const png_decoder::PngInfoOptions& options = {});
+png_decoder::PngInfo ReadPngInfo(std::istream& stream, const png_decoder::PngInfoOptions& options = {});
+png_decoder::PngInfo ReadPngInfo(std::span<const uint8_t> data, const png_decoder::PngInfoOptions& options = {});
@@ -0,0 +1,99 @@
+#pragma once
+
+// stl includes
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+// custom includes
+
+namespace png_decoder {
+
+    // Bounded lock-free queue between exactly one producer and one consumer thread. The fast path is two atomic
+    // loads and a store; a full (producer) or empty (consumer) ring blocks on `std::atomic::wait` until the other
+    // side moves or the ring is aborted.
+    template <class T>
+    class SpscRing {
+    public:
+        // the capacity is rounded up to a power of two
+        explicit SpscRing(size_t capacity) :
+            m_slots(std::bit_ceil(std::max<size_t>(capacity, 1))),
+            m_mask(m_slots.size() - 1),
+            m_head(0),
+            m_tail(0),
+            m_version(0),
+            m_is_aborted(false) {}
+
+        SpscRing(const SpscRing&) = delete;
+        SpscRing& operator=(const SpscRing&) = delete;
+
+        // returns false when the ring was aborted, the value is dropped then
+        bool push(const T& value) {
+            size_t tail = m_tail.load(std::memory_order_relaxed);
+            while (tail - m_head.load(std::memory_order_acquire) == m_slots.size()) {
+                if (!wait_for_change([&] { return tail - m_head.load(std::memory_order_acquire) == m_slots.size(); })) {
+                    return false;
+                }
+            }
+
+            m_slots[tail & m_mask] = value;
+            m_tail.store(tail + 1, std::memory_order_release);
+            signal();
+            return true;
+        }
+
+        // returns false when the ring was aborted
+        bool pop(T& value) {
+            size_t head = m_head.load(std::memory_order_relaxed);
+            while (m_tail.load(std::memory_order_acquire) == head) {
+                if (!wait_for_change([&] { return m_tail.load(std::memory_order_acquire) == head; })) {
+                    return false;
+                }
+            }
+
+            value = m_slots[head & m_mask];
+            m_head.store(head + 1, std::memory_order_release);
+            signal();
+            return true;
+        }
+
+        // wakes up and fails the pending and all later `push` and `pop` calls
+        void abort() noexcept {
+            m_is_aborted.store(true, std::memory_order_release);
+            signal();
+        }
+
+    private:
+        std::vector<T> m_slots;
+        size_t m_mask;
+        // the indices only grow, they are written by one side each and sit on separate cache lines
+        alignas(64) std::atomic<size_t> m_head;
+        alignas(64) std::atomic<size_t> m_tail;
+        // bumped on every change, the blocked side waits for it to move
+        alignas(64) std::atomic<uint32_t> m_version;
+        std::atomic<bool> m_is_aborted;
+
+        void signal() noexcept {
+            m_version.fetch_add(1, std::memory_order_release);
+            m_version.notify_all();
+        }
+
+        // blocks while `is_blocked` holds, returns false when aborted
+        template <class Condition>
+        bool wait_for_change(Condition is_blocked) {
+            // the version is read before the condition is checked again, so a change in between is not missed
+            uint32_t version = m_version.load(std::memory_order_acquire);
+            if (m_is_aborted.load(std::memory_order_acquire)) {
+                return false;
+            }
+            if (is_blocked()) {
+                m_version.wait(version, std::memory_order_acquire);
+            }
+            return !m_is_aborted.load(std::memory_order_acquire);
+        }
+    };
+
+} // namespace png_decoder
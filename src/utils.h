@@ -5,6 +5,8 @@
 #include <iostream>
 #include <string>
 #include <cstring>
+#include <type_traits>
+#include <utility>
 
 // custom includes
 #include "errors.h"
@@ -44,20 +46,31 @@ namespace utils {
     }
     
     
+    // error messages are either strings or callables building them, the latter only run when the error is thrown
+    template <class Message>
+    inline std::string build_message(Message&& message) {
+        if constexpr (std::is_invocable_v<Message>) {
+            return std::forward<Message>(message)();
+        }
+        else {
+            return std::string(std::forward<Message>(message));
+        }
+    }
+
     // read bytes from stream as big-endian and convert the value from big-endian to the endianess of the host machine
     // only supports uint64_t, uint32_t, uint16_t
-    template <class T>
+    template <class T, class Message>
     inline bool read_stream_as_big_endian_and_convert_to_host_endianess(
         std::istream& stream,
         T* destination,
         size_t bytes_count,
-        std::string on_throw_msg
+        Message&& on_throw_msg
     ) {
         if (!stream.read(reinterpret_cast<char*> (destination), bytes_count)) {
             if (stream.eof() && !stream.bad()) {
                 return false;
             }
-            throw png_decoder::error::unable_to_read_from_stream(on_throw_msg);
+            throw png_decoder::error::unable_to_read_from_stream(build_message(std::forward<Message>(on_throw_msg)));
         }
 
         *destination = convert_from_big_endian_to_host(*destination);
@@ -66,76 +79,76 @@ namespace utils {
 
 
     // read bytes from pointer as big-endian and convert the value from big-endian to the endianess of the host machine
-    template <class T>
+    template <class T, class Message>
     inline void read_data_as_big_endian_and_convert_to_host_endianess(
-        char* source,
+        const char* source,
         T* destination,
         size_t bytes_count,
-        std::string on_throw_msg
+        Message&& on_throw_msg
     ) {
         if (!std::memcpy(reinterpret_cast<char*>(destination), source, bytes_count)) {
-            throw png_decoder::error::unable_to_read_from_source(on_throw_msg);
+            throw png_decoder::error::unable_to_read_from_source(build_message(std::forward<Message>(on_throw_msg)));
         }
 
         *destination = convert_from_big_endian_to_host(*destination);
     }
 
     // read bytes from pointer as big-endian and convert the value from big-endian to the endianess of the host machine
-    template <class T>
+    template <class T, class Message>
     inline void read_data_as_big_endian_and_convert_to_host_endianess(
-        unsigned char* source,
+        const unsigned char* source,
         T* destination,
         size_t bytes_count,
-        std::string on_throw_msg
+        Message&& on_throw_msg
     ) {
         if (!std::memcpy(reinterpret_cast<unsigned char*>(destination), source, bytes_count)) {
-            throw png_decoder::error::unable_to_read_from_source(on_throw_msg);
+            throw png_decoder::error::unable_to_read_from_source(build_message(std::forward<Message>(on_throw_msg)));
         }
 
         *destination = convert_from_big_endian_to_host(*destination);
     }
 
     // reads bytes from stream, throws exception with the specified message
-    template <class T>
+    template <class T, class Message>
     inline bool read_as_host_endian(
         std::istream& stream,
         T* destination,
         size_t bytes_count,
-        std::string on_throw_msg
+        Message&& on_throw_msg
     ) {
         if (!stream.read(reinterpret_cast<char*> (destination), bytes_count)) {
             if (stream.eof() && !stream.bad()) {
                 return false;
             }
-            throw png_decoder::error::unable_to_read_from_stream(on_throw_msg);
+            throw png_decoder::error::unable_to_read_from_stream(build_message(std::forward<Message>(on_throw_msg)));
         }
 
         return true;
     }
 
     // reads bytes from pointer, throws exception with the specified message
-    template <class T>
+    template <class T, class Message>
     inline void read_data_as_host_endian(
-        char* source,
+        const char* source,
         T* destination,
         size_t bytes_count,
-        std::string on_throw_msg
+        Message&& on_throw_msg
     ) {
         if (!std::memcpy(reinterpret_cast<char*>(destination), source, bytes_count)) {
-            throw png_decoder::error::unable_to_read_from_source(on_throw_msg);
+            throw png_decoder::error::unable_to_read_from_source(build_message(std::forward<Message>(on_throw_msg)));
         }
     }
 
     // reads bytes from pointer, throws exception with the specified message
-    template <class T>
+    template <class T, class Message>
     inline void read_data_as_host_endian(
-        unsigned char* source,
+        const unsigned char* source,
         T* destination,
         size_t bytes_count,
-        std::string on_throw_msg
+        Message&& on_throw_msg
     ) {
         if (!std::memcpy(reinterpret_cast<unsigned char*>(destination), source, bytes_count)) {
-            throw png_decoder::error::unable_to_read_from_source(on_throw_msg);
+            throw png_decoder::error::unable_to_read_from_source(build_message(std::forward<Message>(on_throw_msg)));
         }
     }
 
@@ -1,5 +1,9 @@
 #include <catch.hpp>
 #include "test_commons.hpp"
+#include <crc_calculator.h>
+#include <defilter_kernels.h>
+#include <random>
+#include <typeinfo>
 
 TEST_CASE("logo") {
     CheckImage("logo.png");
@@ -32,3 +36,858 @@ TEST_CASE("grayscale_alpha_interlace") {
 TEST_CASE("bad_crc") {
     CHECK_THROWS(CheckImage("crc.png"));
 }
+
+TEST_CASE("inflated_data_shorter_than_header") {
+    REQUIRE_THROWS_AS(CheckImage("short_data.png"), png_decoder::inflater::error::unexpected_inflated_size);
+}
+
+TEST_CASE("inflated_data_longer_than_header") {
+    REQUIRE_THROWS_AS(CheckImage("long_data.png"), png_decoder::inflater::error::unexpected_inflated_size);
+}
+
+TEST_CASE("corrupt_inflate_data") {
+    std::ifstream file(kBasePath + "tests/lenna_grayscale.png", std::ios_base::binary);
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    // the blocks still decode, but to fewer bytes than expected and with another checksum
+    bytes[2250] ^= 0x5a;
+
+    png_decoder::DecoderOptions options;
+    options.verify_crc = false;
+    for (auto backend : png_decoder::inflater::available_backends()) {
+        options.inflate_backend = backend;
+        CHECK_THROWS_AS(DecodePng(bytes, options), png_decoder::inflater::error::invalid_inflate_data);
+    }
+
+    // the speculative inflate fails with the same error as the serial one, wherever the data is corrupt
+    png_decoder::DecoderOptions speculative_options = options;
+    speculative_options.speculative_inflate = true;
+    speculative_options.speculative_inflate_threshold = 0;
+    options.inflate_backend = png_decoder::inflater::Backend::ZLIB;
+    auto error_of = [](const std::vector<uint8_t>& data, const png_decoder::DecoderOptions& decoder_options) -> std::string {
+        try {
+            DecodePng(data, decoder_options);
+            return "none";
+        }
+        catch (const std::exception& e) {
+            return typeid(e).name();
+        }
+    };
+
+    speculative_options.thread_count = 4;
+    CHECK_THROWS_AS(DecodePng(bytes, speculative_options), png_decoder::inflater::error::invalid_inflate_data);
+
+    // one corrupt byte at a time in the otherwise intact file
+    bytes[2250] ^= 0x5a;
+    for (size_t position = 45; position + 20 < bytes.size(); position += 1999) {
+        bytes[position] ^= 0x5a;
+        std::string expected = error_of(bytes, options);
+        for (uint32_t thread_count : { 2u, 3u, 8u }) {
+            speculative_options.thread_count = thread_count;
+            CHECK(error_of(bytes, speculative_options) == expected);
+        }
+        bytes[position] ^= 0x5a;
+    }
+}
+
+TEST_CASE("inflate_backends") {
+    // the in-house decoder is only used when asked for
+    CHECK(png_decoder::inflater::default_backend() != png_decoder::inflater::Backend::NATIVE);
+
+    for (auto backend : png_decoder::inflater::available_backends()) {
+        png_decoder::DecoderOptions options;
+        options.inflate_backend = backend;
+
+        CheckImage("logo.png", std::nullopt, options);
+        CheckImage("inter.png", std::nullopt, options);
+    }
+}
+
+TEST_CASE("native_inflate_matches_zlib") {
+    png_decoder::DecoderOptions zlib_options;
+    zlib_options.inflate_backend = png_decoder::inflater::Backend::ZLIB;
+    png_decoder::DecoderOptions native_options;
+    native_options.inflate_backend = png_decoder::inflater::Backend::NATIVE;
+
+    for (const char* filename : { "logo.png", "lenna_grayscale.png", "lenna_index.png", "logo_alpha.png",
+                                  "1.png", "inter.png", "alpha_grayscale.png" }) {
+        auto path = kBasePath + "tests/" + filename;
+        Compare(ReadPng(path, native_options), ReadPng(path, zlib_options));
+    }
+}
+
+TEST_CASE("native_inflate_precode_across_chunks") {
+    // a hand-made stream: a fixed block of 5 nine-bit literals puts the header of the following dynamic block at
+    // bit 71, so its 19 precode lengths (57 bits) start on a byte boundary, the last one with its top bit set
+    std::vector<uint8_t> stream = { 0x78, 0x01 };
+    uint32_t bit_count = 0;
+    auto put = [&](uint32_t value, uint32_t count) {
+        for (uint32_t i = 0; i < count; ++i, ++bit_count) {
+            if (bit_count % 8 == 0) {
+                stream.push_back(0);
+            }
+            stream.back() |= ((value >> i) & 1) << (bit_count % 8);
+        }
+    };
+    // huffman codes go most significant bit first
+    auto put_code = [&](uint32_t code, uint32_t length) {
+        for (uint32_t i = length; i > 0; --i) {
+            put((code >> (i - 1)) & 1, 1);
+        }
+    };
+
+    std::vector<uint8_t> expected(5, 200);
+    expected.resize(45, 'A');
+
+    put(0, 1);
+    put(1, 2);
+    for (int i = 0; i < 5; ++i) {
+        put_code(0b110010000 + 200 - 144, 9);
+    }
+    put_code(0, 7);
+
+    // 257 literal/length and 2 distance codes, all 19 precode lengths: symbol 1 -> 0, 18 -> 10, 0 -> 110,
+    // 15 -> 1110 (unused) and 17 -> 1111
+    put(1, 1);
+    put(2, 2);
+    put(0, 5);
+    put(1, 5);
+    put(15, 4);
+    for (uint32_t symbol : { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 }) {
+        put(symbol == 1 ? 1 : symbol == 18 ? 2 : symbol == 0 ? 3 : symbol == 17 || symbol == 15 ? 4 : 0, 3);
+    }
+    // 'A' and the end of block take 1 bit each, both distance codes 1 bit
+    put_code(0b10, 2);
+    put(65 - 11, 7);
+    put_code(0, 1);
+    put_code(0b10, 2);
+    put(138 - 11, 7);
+    put_code(0b10, 2);
+    put(52 - 11, 7);
+    put_code(0, 1);
+    put_code(0, 1);
+    put_code(0, 1);
+    for (int i = 0; i < 40; ++i) {
+        put_code(0, 1);
+    }
+    put_code(1, 1);
+
+    uint32_t adler_a = 1;
+    uint32_t adler_b = 0;
+    for (uint8_t byte : expected) {
+        adler_a = (adler_a + byte) % 65521;
+        adler_b = (adler_b + adler_a) % 65521;
+    }
+    uint32_t adler = (adler_b << 16) | adler_a;
+    for (int shift : { 24, 16, 8, 0 }) {
+        stream.push_back(static_cast<uint8_t>(adler >> shift));
+    }
+
+    // every split into two IDAT chunks, some leave the precode to the byte by byte refill at the chunk end
+    for (auto backend : { png_decoder::inflater::Backend::ZLIB, png_decoder::inflater::Backend::NATIVE }) {
+        auto inflater = png_decoder::inflater::InflateBackend::create_backend(backend);
+        for (size_t split = 0; split <= stream.size(); ++split) {
+            std::vector<uint8_t> actual(expected.size());
+            inflater->inflate({ { stream.data(), split }, { stream.data() + split, stream.size() - split } }, actual);
+            INFO(png_decoder::inflater::to_string(backend) << ", split at " << split);
+            REQUIRE(actual == expected);
+        }
+    }
+}
+
+TEST_CASE("decoder_context_reuse") {
+    png_decoder::DecoderContext context;
+
+    for (auto backend : png_decoder::inflater::available_backends()) {
+        png_decoder::DecoderOptions options;
+        options.inflate_backend = backend;
+
+        for (const char* filename : { "logo.png", "inter.png", "lenna_index.png", "logo.png" }) {
+            auto path = kBasePath + "tests/" + filename;
+            Compare(ReadPng(path, context, options), libpng::ReadImage(path));
+        }
+    }
+}
+
+TEST_CASE("decoder_context_arena") {
+    png_decoder::DecoderContext context;
+    png_decoder::DecoderOptions options;
+    options.inflate_backend = png_decoder::inflater::Backend::ZLIB;
+    auto path = kBasePath + "tests/lenna_index.png";
+
+    // zlib state comes from the context, the per-decode arena is released after each decode
+    Compare(ReadPng(path, context, options), libpng::ReadImage(path));
+    REQUIRE(context.get_chunks().empty());
+    REQUIRE(context.get_image_data().empty());
+
+    CHECK_THROWS(ReadPng(kBasePath + "tests/crc.png", context, options));
+    REQUIRE(context.get_chunks().empty());
+    Compare(ReadPng(path, context, options), libpng::ReadImage(path));
+}
+
+TEST_CASE("arena_release") {
+    png_decoder::Arena arena(64);
+    std::pmr::vector<uint32_t> small(10, 1, &arena);
+    std::pmr::vector<uint8_t> big(1000, 2, &arena);
+    REQUIRE(arena.get_allocated_bytes() >= 1040);
+    REQUIRE(reinterpret_cast<uintptr_t>(small.data()) % alignof(uint32_t) == 0);
+
+    small = std::pmr::vector<uint32_t>(&arena);
+    big = std::pmr::vector<uint8_t>(&arena);
+    arena.release();
+    REQUIRE(arena.get_allocated_bytes() == 0);
+
+    std::pmr::vector<uint8_t> reused(1000, 3, &arena);
+    REQUIRE(reused.back() == 3);
+}
+
+TEST_CASE("idot_parallel_inflate") {
+    for (uint32_t thread_count : { 1u, 2u, 4u }) {
+        png_decoder::DecoderOptions options;
+        options.thread_count = thread_count;
+
+        CheckImage("idot.png", std::nullopt, options);
+    }
+
+    png_decoder::DecoderOptions serial_options;
+    serial_options.parallel_inflate = false;
+    CheckImage("idot.png", std::nullopt, serial_options);
+
+    // offsets which do not match the IDAT layout fall back to the serial path
+    CheckImage("idot_bad_offsets.png");
+}
+
+TEST_CASE("speculative_inflate") {
+    png_decoder::DecoderOptions options;
+    options.speculative_inflate = true;
+    options.speculative_inflate_threshold = 0;
+
+    for (uint32_t thread_count : { 2u, 3u, 8u }) {
+        options.thread_count = thread_count;
+
+        for (const char* filename : { "logo.png", "lenna_grayscale.png", "lenna_index.png", "1.png", "inter.png" }) {
+            CheckImage(filename, std::nullopt, options);
+        }
+    }
+
+    REQUIRE_THROWS_AS(CheckImage("short_data.png", std::nullopt, options), png_decoder::inflater::error::unexpected_inflated_size);
+    REQUIRE_THROWS_AS(CheckImage("long_data.png", std::nullopt, options), png_decoder::inflater::error::unexpected_inflated_size);
+
+    // the ranges are counted against the memory budget, an image they do not fit in is inflated serially
+    auto path = kBasePath + "tests/lenna_grayscale.png";
+    std::ifstream file(path, std::ios_base::binary);
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    auto info = ReadPngInfo(bytes);
+    uint64_t inflated_size = static_cast<uint64_t>(info.height) * (info.width + 1);
+    uint64_t working_set = png_decoder::inflater::SpeculativeInflater::working_set_size(inflated_size, 4);
+    options.thread_count = 4;
+    options.limits.max_memory = inflated_size + static_cast<uint64_t>(info.width) * info.height * sizeof(RGBA8);
+    Compare(DecodePng(bytes, options), libpng::ReadImage(path));
+    options.limits.max_memory += working_set;
+    Compare(DecodePng(bytes, options), libpng::ReadImage(path));
+
+    // a range outgrowing its share of the memory leaves the stream to the backend
+    std::vector<std::span<const uint8_t>> data_chunks;
+    for (size_t offset = 8; offset + 12 <= bytes.size(); ) {
+        uint32_t length = 0;
+        for (size_t i = 0; i < 4; ++i) {
+            length = (length << 8) | bytes[offset + i];
+        }
+        if (std::equal(bytes.begin() + offset + 4, bytes.begin() + offset + 8, "IDAT")) {
+            data_chunks.emplace_back(bytes.data() + offset + 8, length);
+        }
+        offset += 12 + length;
+    }
+
+    png_decoder::inflater::Inflater inflater(png_decoder::inflater::Backend::ZLIB);
+    std::vector<uint8_t> expected(inflated_size);
+    inflater.inflate(data_chunks, expected);
+    for (uint64_t max_memory : { uint64_t(0), working_set / 8, working_set }) {
+        std::vector<uint8_t> actual(inflated_size);
+        inflater.set_speculative_inflate(4, 0, max_memory);
+        inflater.inflate(data_chunks, actual);
+        REQUIRE(actual == expected);
+    }
+}
+
+TEST_CASE("crc32_implementations") {
+    using namespace png_decoder::crc_calculator;
+
+    std::vector<uint8_t> data(5000);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<uint8_t>(i * 7 + (i >> 5));
+    }
+    const uint32_t expected = update_crc32_checksum(Implementation::SLICE_BY_16, 0, data.data(), data.size());
+
+    for (auto implementation : available_implementations()) {
+        REQUIRE(update_crc32_checksum(implementation, 0, "123456789", 9) == 0xCBF43926);
+
+        // every split point around the 16 and 64 byte block sizes gives the same result
+        for (size_t split : { 0, 1, 15, 16, 17, 63, 64, 65, 129, 4999, 5000 }) {
+            uint32_t crc = update_crc32_checksum(implementation, 0, data.data(), split);
+            crc = update_crc32_checksum(implementation, crc, data.data() + split, data.size() - split);
+            REQUIRE(crc == expected);
+
+            uint32_t second = update_crc32_checksum(implementation, 0, data.data() + split, data.size() - split);
+            uint32_t first = update_crc32_checksum(implementation, 0, data.data(), split);
+            REQUIRE(combine_crc32_checksums(first, second, data.size() - split) == expected);
+        }
+    }
+}
+
+TEST_CASE("crc_checked_while_reading") {
+    std::ifstream file(kBasePath + "tests/crc.png", std::ios_base::binary);
+    std::istringstream stream(std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>()));
+
+    // the corrupt pHYs chunk ends at offset 132, nothing past it is read
+    png_decoder::PNGDecoder decoder(stream);
+    REQUIRE_THROWS_AS(decoder.decode(), png_decoder::error::invalid_crc_checksum);
+    REQUIRE(stream.tellg() == 132);
+}
+
+TEST_CASE("parallel_crc") {
+    std::ifstream file(kBasePath + "tests/idot.png", std::ios_base::binary);
+    std::string bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    // corrupt the data of IDAT chunks 11 and 13
+    bytes[3441 + 8 + 100] ^= 0x55;
+    bytes[8533 + 8 + 100] ^= 0x55;
+
+    for (uint32_t thread_count : { 1u, 2u, 4u }) {
+        for (bool parallel_crc : { false, true }) {
+            png_decoder::DecoderOptions options;
+            options.thread_count = thread_count;
+            options.parallel_crc = parallel_crc;
+            options.parallel_crc_threshold = 0;
+
+            // the first bad chunk is reported, not the inflate error the corruption causes
+            std::istringstream stream(bytes);
+            png_decoder::PNGDecoder decoder(stream, options);
+            REQUIRE_THROWS_WITH(decoder.decode(), Catch::Contains("chunk number 11:"));
+
+            CheckImage("idot.png", std::nullopt, options);
+        }
+    }
+
+    png_decoder::DecoderOptions unchecked_options;
+    unchecked_options.verify_crc = false;
+    CheckImage("crc.png", std::nullopt, unchecked_options);
+
+    // a bad tEXt after the image data is checked while reading, the deferred check of the bad IDAT before it
+    // still decides which chunk is reported
+    std::ifstream logo_file(kBasePath + "tests/logo.png", std::ios_base::binary);
+    std::string logo((std::istreambuf_iterator<char>(logo_file)), std::istreambuf_iterator<char>());
+    logo[151 + 8 + 100] ^= 0x55;
+    logo[9082 + 8 + 3] ^= 0x55;
+    for (uint32_t thread_count : { 1u, 4u }) {
+        for (size_t threshold : { size_t(0), std::numeric_limits<size_t>::max() }) {
+            png_decoder::DecoderOptions options;
+            options.thread_count = thread_count;
+            options.parallel_crc_threshold = threshold;
+
+            std::istringstream stream(logo);
+            png_decoder::PNGDecoder decoder(stream, options);
+            REQUIRE_THROWS_WITH(decoder.decode(), Catch::Contains("chunk number 6:"));
+            auto data = reinterpret_cast<const uint8_t*>(logo.data());
+            REQUIRE_THROWS_WITH(DecodePng({ data, logo.size() }, options), Catch::Contains("chunk number 6:"));
+        }
+    }
+}
+
+TEST_CASE("mapped_input") {
+    png_decoder::DecoderContext context;
+
+    for (const char* filename : { "logo.png", "lenna_grayscale.png", "lenna_index.png", "logo_alpha.png",
+                                  "1.png", "inter.png", "alpha_grayscale.png", "idot.png" }) {
+        auto path = kBasePath + "tests/" + filename;
+        Compare(ReadPngMapped(path, context), libpng::ReadImage(path));
+    }
+
+    CHECK_THROWS_AS(ReadPngMapped(kBasePath + "tests/crc.png", context), png_decoder::error::invalid_crc_checksum);
+    CHECK_THROWS_AS(ReadPngMapped(kBasePath + "tests/long_data.png", context), png_decoder::inflater::error::unexpected_inflated_size);
+    CHECK_THROWS_AS(ReadPngMapped(kBasePath + "tests/missing.png"), error::unable_to_open_file);
+}
+
+TEST_CASE("decode_from_memory") {
+    png_decoder::DecoderContext context;
+
+    for (const char* filename : { "logo.png", "lenna_index.png", "inter.png", "idot.png" }) {
+        auto path = kBasePath + "tests/" + filename;
+        std::ifstream file(path, std::ios_base::binary);
+        std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        auto expected = libpng::ReadImage(path);
+
+        Compare(DecodePng(bytes), expected);
+        Compare(DecodePng(bytes, context), expected);
+
+        // a chunk cut short by the end of the input is an error, not an early end
+        bytes.resize(bytes.size() - 20);
+        CHECK_THROWS_AS(DecodePng(bytes, context), png_decoder::error::unable_to_read_from_source);
+    }
+
+    std::vector<uint8_t> too_short = { 0x89, 'P', 'N', 'G' };
+    CHECK_THROWS_AS(DecodePng(too_short), png_decoder::error::unable_to_read_from_source);
+}
+
+// a stream which cannot seek, like a pipe
+class ForwardOnlyBuffer : public std::streambuf {
+public:
+    explicit ForwardOnlyBuffer(std::string bytes) : bytes_(std::move(bytes)) {
+        setg(bytes_.data(), bytes_.data(), bytes_.data() + bytes_.size());
+    }
+private:
+    std::string bytes_;
+};
+
+TEST_CASE("png_info") {
+    auto path = kBasePath + "tests/logo.png";
+    auto image = libpng::ReadImage(path);
+
+    // header only
+    auto info = ReadPngInfo(path);
+    REQUIRE(info.width == static_cast<uint32_t>(image.Width()));
+    REQUIRE(info.height == static_cast<uint32_t>(image.Height()));
+    REQUIRE(info.bit_depth == 8);
+    REQUIRE(info.color_type == 2);
+    REQUIRE(info.interlace_method == 0);
+    REQUIRE(!info.physical_dimensions.has_value());
+
+    // logo.png keeps its tEXt chunks after the image data
+    png_decoder::PngInfoOptions options;
+    options.read_metadata = true;
+    info = ReadPngInfo(path, options);
+    REQUIRE(info.physical_dimensions.has_value());
+    REQUIRE(info.physical_dimensions->pixels_per_unit_x == 2835);
+    REQUIRE(info.physical_dimensions->unit == 1);
+    REQUIRE(info.text.empty());
+
+    options.read_trailing_metadata = true;
+    std::ifstream file(path, std::ios_base::binary);
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    info = ReadPngInfo(bytes, options);
+    REQUIRE(info.text.size() == 3);
+    REQUIRE(info.text[0].keyword == "Comment");
+    REQUIRE(info.text[0].text == "Created with GIMP");
+
+    // a stream which cannot seek reads the image data through
+    ForwardOnlyBuffer forward_buffer(std::string(bytes.begin(), bytes.end()));
+    std::istream forward_stream(&forward_buffer);
+    info = ReadPngInfo(forward_stream, options);
+    REQUIRE(info.text.size() == 3);
+    REQUIRE(info.text[0].text == "Created with GIMP");
+
+    // crc.png has a broken pHYs chunk, which is never read for the header alone
+    REQUIRE(ReadPngInfo(kBasePath + "tests/crc.png").width == 88);
+    CHECK_THROWS_AS(ReadPngInfo(kBasePath + "tests/crc.png", options), png_decoder::error::invalid_crc_checksum);
+
+    // truncated input throws instead of returning what was read so far
+    std::vector<uint8_t> truncated(bytes.begin(), bytes.end() - 30);
+    CHECK_THROWS_AS(ReadPngInfo(truncated, options), png_decoder::error::unable_to_read_from_source);
+    std::istringstream truncated_stream(std::string(truncated.begin(), truncated.end()));
+    CHECK_THROWS_AS(ReadPngInfo(truncated_stream, options), png_decoder::error::unable_to_read_from_stream);
+    // inside a skipped IDAT
+    truncated.resize(33 + 100);
+    CHECK_THROWS_AS(ReadPngInfo(truncated, options), png_decoder::error::unable_to_read_from_source);
+    std::istringstream skipped_stream(std::string(truncated.begin(), truncated.end()));
+    CHECK_THROWS_AS(ReadPngInfo(skipped_stream, options), png_decoder::error::unable_to_read_from_stream);
+    ForwardOnlyBuffer skipped_buffer(std::string(truncated.begin(), truncated.end()));
+    std::istream skipped_forward_stream(&skipped_buffer);
+    CHECK_THROWS_AS(ReadPngInfo(skipped_forward_stream, options), png_decoder::error::unable_to_read_from_stream);
+
+    // a tEXt announcing 4 GiB is not allocated before its data is there
+    std::vector<uint8_t> huge_text(bytes.begin(), bytes.begin() + 33);
+    const uint8_t huge_text_chunk[] = { 0xff, 0xff, 0xff, 0xf0, 't', 'E', 'X', 't', 'a', 0, 'b' };
+    huge_text.insert(huge_text.end(), std::begin(huge_text_chunk), std::end(huge_text_chunk));
+    CHECK_THROWS_AS(ReadPngInfo(huge_text, options), png_decoder::error::limit_exceeded);
+    options.max_chunk_size = std::numeric_limits<uint32_t>::max();
+    CHECK_THROWS_AS(ReadPngInfo(huge_text, options), png_decoder::error::unable_to_read_from_source);
+    std::istringstream huge_stream(std::string(huge_text.begin(), huge_text.end()));
+    CHECK_THROWS_AS(ReadPngInfo(huge_stream, options), png_decoder::error::unable_to_read_from_stream);
+}
+
+TEST_CASE("chunk_tags") {
+    using namespace png_decoder;
+    static_assert(chunk_tag::IHDR == 0x49484452);
+
+    const uint8_t type[] = { 'I', 'D', 'A', 'T' };
+    Chunk chunk(read_chunk_tag(type), {}, 0);
+    REQUIRE(chunk.get_type() == Chunk::ChunkType::DATA);
+    REQUIRE(chunk.get_type_label() == "IDAT");
+    REQUIRE(Chunk(chunk_tag::tEXt, {}, 0).get_type() == Chunk::ChunkType::ANCILLARY);
+}
+
+TEST_CASE("retained_chunks") {
+    png_decoder::DecoderOptions options;
+    // nothing ancillary is kept, iDOT still is for the parallel inflate
+    options.retained_chunks.emplace();
+
+    for (const char* filename : { "logo.png", "lenna_grayscale.png", "lenna_index.png", "inter.png", "idot.png" }) {
+        CheckImage(filename, std::nullopt, options);
+        Compare(ReadPngMapped(kBasePath + "tests/" + filename, options), libpng::ReadImage(kBasePath + "tests/" + filename));
+    }
+
+    // skipped chunks are still checked
+    CHECK_THROWS_AS(CheckImage("crc.png", std::nullopt, options), png_decoder::error::invalid_crc_checksum);
+    CHECK_THROWS_AS(ReadPngMapped(kBasePath + "tests/crc.png", options), png_decoder::error::invalid_crc_checksum);
+
+    // and errors count the chunks of the file, skipped ones included: the bad tEXt is chunk 7, the bad IDAT 11
+    std::ifstream file(kBasePath + "tests/idot.png", std::ios_base::binary);
+    std::string bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    for (size_t offset : { size_t(188 + 8 + 3), size_t(3441 + 8 + 100) }) {
+        std::string corrupt = bytes;
+        corrupt[offset] ^= 0x55;
+        const char* number = offset < 3441 ? "chunk number 7:" : "chunk number 11:";
+        for (uint32_t thread_count : { 1u, 4u }) {
+            options.thread_count = thread_count;
+            options.parallel_crc_threshold = 0;
+            std::istringstream stream(corrupt);
+            png_decoder::PNGDecoder decoder(stream, options);
+            CHECK_THROWS_WITH(decoder.decode(), Catch::Contains(number));
+            CHECK_THROWS_WITH(DecodePng({ reinterpret_cast<const uint8_t*>(corrupt.data()), corrupt.size() }, options), Catch::Contains(number));
+        }
+    }
+    options.thread_count = 0;
+
+    // or skipped with a seek
+    options.verify_crc = false;
+    CheckImage("crc.png", std::nullopt, options);
+
+    options.retained_chunks = std::vector<png_decoder::ChunkTag>{ png_decoder::chunk_tag::pHYs };
+    CheckImage("crc.png", std::nullopt, options);
+}
+
+TEST_CASE("decode_limits") {
+    auto path = kBasePath + "tests/logo.png";
+    std::ifstream file(path, std::ios_base::binary);
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    Compare(DecodePng(bytes), libpng::ReadImage(path));
+
+    png_decoder::DecoderOptions options;
+    options.limits.max_chunk_size = 1024;
+    CHECK_THROWS_AS(DecodePng(bytes, options), png_decoder::error::limit_exceeded);
+    CHECK_THROWS_AS(ReadPng(path, options), png_decoder::error::limit_exceeded);
+
+    options = {};
+    options.limits.max_memory = 1024;
+    CHECK_THROWS_AS(DecodePng(bytes, options), png_decoder::error::limit_exceeded);
+    CHECK_THROWS_AS(ReadPng(path, options), png_decoder::error::limit_exceeded);
+
+    options = {};
+    options.limits.max_pixels = 100;
+    CHECK_THROWS_AS(DecodePng(bytes, options), png_decoder::error::limit_exceeded);
+
+    // a header announcing a huge image is rejected before anything is inflated
+    const size_t header_data = 16;
+    uint8_t huge[8] = { 0x7f, 0xff, 0xff, 0xff, 0x7f, 0xff, 0xff, 0xff };
+    std::copy(std::begin(huge), std::end(huge), bytes.begin() + header_data);
+    uint32_t crc = png_decoder::crc_calculator::update_crc32_checksum(0, bytes.data() + header_data - 4, 4 + 13);
+    for (size_t i = 0; i < 4; ++i) {
+        bytes[header_data + 13 + i] = static_cast<uint8_t>(crc >> (24 - 8 * i));
+    }
+    CHECK_THROWS_AS(DecodePng(bytes), png_decoder::error::limit_exceeded);
+
+    options = {};
+    options.limits.max_width = options.limits.max_height = 0x7fffffff;
+    options.limits.max_pixels = options.limits.max_inflated_size = std::numeric_limits<uint64_t>::max();
+    CHECK_THROWS_AS(DecodePng(bytes, options), png_decoder::error::limit_exceeded);
+}
+
+TEST_CASE("truncated_chunks") {
+    std::ifstream file(kBasePath + "tests/logo.png", std::ios_base::binary);
+    std::string bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    // signature and IHDR, then an IDAT announcing far more data than follows
+    for (uint32_t length : { 0x10000000u, 0x7ffffff0u }) {
+        std::string truncated = bytes.substr(0, 33);
+        for (size_t i = 0; i < 4; ++i) {
+            truncated += static_cast<char>(length >> (24 - 8 * i));
+        }
+        truncated += "IDAT" + std::string(16, 'x');
+
+        std::istringstream stream(truncated);
+        png_decoder::PNGDecoder decoder(stream);
+        CHECK_THROWS_AS(decoder.decode(), png_decoder::error::unable_to_read_from_stream);
+
+        // without a size to check against, the buffer only grows with the data read
+        ForwardOnlyBuffer buffer(truncated);
+        std::istream forward_stream(&buffer);
+        png_decoder::PNGDecoder forward_decoder(forward_stream);
+        CHECK_THROWS_AS(forward_decoder.decode(), png_decoder::error::unable_to_read_from_stream);
+
+        std::span<const uint8_t> data(reinterpret_cast<const uint8_t*>(truncated.data()), truncated.size());
+        CHECK_THROWS_AS(DecodePng(data), png_decoder::error::unable_to_read_from_source);
+    }
+
+    // large chunks read through a stream which cannot seek come out whole
+    std::string big;
+    {
+        std::ifstream big_file(kBasePath + "tests/inter.png", std::ios_base::binary);
+        big.assign((std::istreambuf_iterator<char>(big_file)), std::istreambuf_iterator<char>());
+    }
+    ForwardOnlyBuffer big_buffer(big);
+    std::istream big_stream(&big_buffer);
+    png_decoder::PNGDecoder big_decoder(big_stream);
+    Compare(big_decoder.decode(), libpng::ReadImage(kBasePath + "tests/inter.png"));
+
+    // a missing crc is an error, not the end of the file
+    std::istringstream no_crc(bytes.substr(0, bytes.size() - 2));
+    png_decoder::PNGDecoder no_crc_decoder(no_crc);
+    CHECK_THROWS_AS(no_crc_decoder.decode(), png_decoder::error::unable_to_read_from_stream);
+
+    // crc errors name the chunk, without its data
+    std::string corrupt = bytes;
+    corrupt[33 + 8 + 100] ^= 0x55;
+    std::istringstream corrupt_stream(corrupt);
+    png_decoder::PNGDecoder corrupt_decoder(corrupt_stream);
+    try {
+        corrupt_decoder.decode();
+        FAIL("corrupt data was decoded");
+    }
+    catch (const png_decoder::error::invalid_crc_checksum& e) {
+        CHECK(std::string(e.what()).size() < 256);
+    }
+}
+
+TEST_CASE("defilter_kernels") {
+    using namespace png_decoder::defilter_kernels;
+    std::mt19937 random(7);
+    std::uniform_int_distribution<int> byte(0, 255);
+
+    for (uint32_t bpp : { 1u, 2u, 3u, 4u, 6u, 8u }) {
+        for (uint8_t filter_type = 0; filter_type < 5; ++filter_type) {
+            // lengths around the register widths and their tails
+            for (size_t pixels : { 0, 1, 2, 5, 11, 16, 33, 100 }) {
+                size_t length = pixels * bpp;
+                std::vector<uint8_t> row(length);
+                std::vector<uint8_t> prior(length);
+                for (size_t i = 0; i < length; ++i) {
+                    row[i] = static_cast<uint8_t>(byte(random));
+                    prior[i] = static_cast<uint8_t>(byte(random));
+                }
+
+                auto expected = row;
+                get_kernel(Implementation::SCALAR, filter_type, bpp)(expected.data(), prior.data(), length);
+
+                for (auto implementation : available_implementations()) {
+                    auto actual = row;
+                    get_kernel(implementation, filter_type, bpp)(actual.data(), prior.data(), length);
+                    INFO(to_string(implementation) << ", filter " << int(filter_type) << ", bpp " << bpp << ", length " << length);
+                    REQUIRE(actual == expected);
+                }
+            }
+        }
+    }
+
+    CHECK(get_kernel(5, 1) == nullptr);
+    CHECK(get_kernel(1, 5) == nullptr);
+}
+
+TEST_CASE("fused_rows") {
+    png_decoder::DecoderOptions options;
+    options.fused_rows = true;
+
+    for (const char* filename : { "logo.png", "lenna_grayscale.png", "lenna_index.png", "logo_alpha.png", "1.png", "inter.png", "alpha_grayscale.png", "idot.png" }) {
+        CheckImage(filename, std::nullopt, options);
+    }
+
+    png_decoder::DecoderContext context;
+    for (const char* filename : { "inter.png", "logo.png" }) {
+        auto path = kBasePath + "tests/" + filename;
+        Compare(ReadPng(path, context, options), libpng::ReadImage(path));
+    }
+
+    CHECK_THROWS_AS(CheckImage("short_data.png", std::nullopt, options), png_decoder::inflater::error::unexpected_inflated_size);
+    CHECK_THROWS_AS(CheckImage("long_data.png", std::nullopt, options), png_decoder::inflater::error::unexpected_inflated_size);
+    CHECK_THROWS_AS(CheckImage("crc.png", std::nullopt, options), png_decoder::error::invalid_crc_checksum);
+
+    // the zlib state comes from the given resource, is kept between streams and is counted against `max_memory`
+    png_decoder::Arena arena;
+    png_decoder::inflater::StreamInflater stream_inflater(&arena);
+    std::vector<uint8_t> text(100000);
+    for (size_t i = 0; i < text.size(); ++i) {
+        text[i] = static_cast<uint8_t>(i % 251);
+    }
+    std::vector<uint8_t> compressed(compressBound(static_cast<uLong>(text.size())));
+    uLongf compressed_size = static_cast<uLongf>(compressed.size());
+    REQUIRE(compress(compressed.data(), &compressed_size, text.data(), static_cast<uLong>(text.size())) == Z_OK);
+    std::vector<uint8_t> inflated(text.size());
+    for (int stream = 0; stream < 2; ++stream) {
+        // in rows, as the decoder reads it: zlib keeps its window between the reads
+        stream_inflater.begin({ { compressed.data(), compressed_size } });
+        for (size_t offset = 0; offset < inflated.size(); offset += 1000) {
+            stream_inflater.read({ inflated.data() + offset, 1000 });
+        }
+        stream_inflater.finish();
+        REQUIRE(inflated == text);
+    }
+    CHECK(arena.get_allocated_bytes() > 32 * 1024);
+    CHECK(arena.get_allocated_bytes() <= png_decoder::inflater::StreamInflater::STATE_SIZE);
+
+    std::ifstream file(kBasePath + "tests/lenna_grayscale.png", std::ios_base::binary);
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    // the 386 x 472 image, two rows with their filter type bytes and the zlib state
+    options.limits.max_memory = 386 * 472 * 4 + 2 * 387 + png_decoder::inflater::StreamInflater::STATE_SIZE;
+    Compare(DecodePng(bytes, options), ReadPng(kBasePath + "tests/lenna_grayscale.png"));
+    options.limits.max_memory -= 1;
+    CHECK_THROWS_AS(DecodePng(bytes, options), png_decoder::error::limit_exceeded);
+}
+
+TEST_CASE("pipelined_rows") {
+    // the fused rows on the calling thread, one and several conversion workers, whatever the machine has
+    for (uint32_t thread_count : { 1u, 3u, 6u }) {
+        png_decoder::DecoderOptions options;
+        options.pipelined_rows = true;
+        options.thread_count = thread_count;
+
+        for (const char* filename : { "logo.png", "lenna_grayscale.png", "lenna_index.png", "logo_alpha.png", "1.png", "inter.png", "alpha_grayscale.png", "idot.png" }) {
+            CheckImage(filename, std::nullopt, options);
+        }
+
+        png_decoder::DecoderContext context;
+        for (const char* filename : { "inter.png", "logo.png" }) {
+            auto path = kBasePath + "tests/" + filename;
+            Compare(ReadPng(path, context, options), libpng::ReadImage(path));
+        }
+
+        CHECK_THROWS_AS(CheckImage("short_data.png", std::nullopt, options), png_decoder::inflater::error::unexpected_inflated_size);
+        CHECK_THROWS_AS(CheckImage("long_data.png", std::nullopt, options), png_decoder::inflater::error::unexpected_inflated_size);
+        CHECK_THROWS_AS(CheckImage("crc.png", std::nullopt, options), png_decoder::error::invalid_crc_checksum);
+    }
+
+    // one thread takes the fused rows, which need neither worker threads nor the memory of the pipeline batches
+    std::ifstream file(kBasePath + "tests/lenna_grayscale.png", std::ios_base::binary);
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    png_decoder::DecoderOptions options;
+    options.pipelined_rows = true;
+    options.thread_count = 1;
+    options.limits.max_memory = 386 * 472 * 4 + 128 * 1024;
+    Compare(DecodePng(bytes, options), ReadPng(kBasePath + "tests/lenna_grayscale.png"));
+    options.thread_count = 3;
+    CHECK_THROWS_AS(DecodePng(bytes, options), png_decoder::error::limit_exceeded);
+}
+
+TEST_CASE("parallel_interlace") {
+    // the passes are defiltered and the tile bands converted on several workers
+    for (uint32_t thread_count : { 1u, 3u, 8u }) {
+        png_decoder::DecoderOptions options;
+        options.thread_count = thread_count;
+
+        for (const char* filename : { "inter.png", "alpha_grayscale.png", "logo.png", "1.png" }) {
+            CheckImage(filename, std::nullopt, options);
+        }
+    }
+}
+
+TEST_CASE("pixel_formats") {
+    // 16-bit samples keep their high byte and low bit depths are stretched to 8 bits, as libpng reads them
+    for (const char* filename : { "gray16.png", "gray_alpha16.png", "rgba16_interlaced.png", "gray2.png" }) {
+        CheckImage(filename);
+    }
+
+    static_assert(sizeof(Image::PixelType) == 4);
+    static_assert(Image::LAYOUT.format == PixelFormat::RGBA8);
+    static_assert(RGBA16Image::LAYOUT.bytes_per_pixel() == 8);
+    static_assert(Gray8Image::LAYOUT.bytes_per_pixel() == 1 && !Gray8Image::LAYOUT.has_alpha);
+
+    auto image = ReadPng(kBasePath + "tests/logo_alpha.png");
+    REQUIRE(image.Stride() == 4 * static_cast<size_t>(image.Width()));
+    Compare(ConvertImage<RGBA8>(ConvertImage<RGBA16>(image)), image);
+
+    auto wide = ConvertImage<RGBA16>(image);
+    auto rgb = ConvertImage<RGB8>(image);
+    auto gray_alpha = ConvertImage<GrayA8>(image);
+    for (int y = 0; y < image.Height(); ++y) {
+        for (int x = 0; x < image.Width(); ++x) {
+            const RGBA8& pixel = image(y, x);
+            REQUIRE(wide(y, x) == RGBA16{ uint16_t(pixel.r * 257), uint16_t(pixel.g * 257), uint16_t(pixel.b * 257), uint16_t(pixel.a * 257) });
+            REQUIRE(rgb(y, x) == RGB8{ pixel.r, pixel.g, pixel.b });
+            REQUIRE(gray_alpha(y, x).a == pixel.a);
+        }
+    }
+
+    // gray images come back unchanged through the gray format
+    auto gray = ReadPng(kBasePath + "tests/lenna_grayscale.png");
+    Compare(ConvertImage<RGBA8>(ConvertImage<Gray8>(gray)), gray);
+
+    // the decoder writes the requested format directly, as `ConvertImage` would from RGBA8 but with all 16 bits
+    auto is_same = [](const auto& actual, const auto& expected) {
+        return actual.Height() == expected.Height() && actual.Width() == expected.Width() &&
+            std::equal(actual.Data(), actual.Data() + static_cast<size_t>(actual.Width()) * actual.Height(), expected.Data());
+    };
+    CHECK(is_same(ReadPng<Gray8>(kBasePath + "tests/lenna_grayscale.png"), ConvertImage<Gray8>(gray)));
+    for (const char* filename : { "logo_alpha.png", "1.png", "inter.png", "gray2.png" }) {
+        auto rgba = ReadPng(kBasePath + "tests/" + filename);
+        CHECK(is_same(ReadPng<Gray8>(kBasePath + "tests/" + filename), ConvertImage<Gray8>(rgba)));
+        CHECK(is_same(ReadPng<GrayA8>(kBasePath + "tests/" + filename), ConvertImage<GrayA8>(rgba)));
+        CHECK(is_same(ReadPng<RGB8>(kBasePath + "tests/" + filename), ConvertImage<RGB8>(rgba)));
+        CHECK(is_same(ReadPng<RGBA16>(kBasePath + "tests/" + filename), ConvertImage<RGBA16>(rgba)));
+    }
+
+    png_decoder::DecoderOptions fused;
+    fused.fused_rows = true;
+    png_decoder::DecoderOptions pipelined;
+    pipelined.pipelined_rows = true;
+    for (const char* filename : { "gray16.png", "gray_alpha16.png", "rgba16_interlaced.png" }) {
+        auto wide = ReadPng<RGBA16>(kBasePath + "tests/" + filename);
+        CHECK(is_same(ConvertImage<RGBA8>(wide), ReadPng(kBasePath + "tests/" + filename)));
+        CHECK(is_same(ReadPng<RGBA16>(kBasePath + "tests/" + filename, fused), wide));
+        CHECK(is_same(ReadPng<RGBA16>(kBasePath + "tests/" + filename, pipelined), wide));
+
+        bool has_low_bytes = false;
+        for (int y = 0; y < wide.Height(); ++y) {
+            for (int x = 0; x < wide.Width(); ++x) {
+                has_low_bytes |= (wide(y, x).r & 0xff) != (wide(y, x).r >> 8);
+            }
+        }
+        CHECK(has_low_bytes);
+    }
+
+    // the image is accounted in the requested format
+    png_decoder::DecoderOptions limited;
+    // 386 x 472 pixels, the inflated data and the Gray8 image take about a byte per pixel each
+    limited.limits.max_memory = 386 * 472 * 3;
+    CHECK_NOTHROW(ReadPng<Gray8>(kBasePath + "tests/lenna_grayscale.png", limited));
+    CHECK_THROWS_AS(ReadPng(kBasePath + "tests/lenna_grayscale.png", limited), png_decoder::error::limit_exceeded);
+}
+
+TEST_CASE("convert_row") {
+    using png_decoder::PixelReader;
+    png_decoder::Pallete pallete;
+    pallete.entries = { { 10, 20, 30 }, { 40, 50, 60 } };
+
+    // 4-bit grey scale is stretched, samples are packed from the most significant bit on
+    const uint8_t grey4[] = { 0x0f, 0x8f };
+    std::vector<RGBA8> pixels(4);
+    PixelReader(PixelReader::PixelType::GREYSCALE, 4, pallete).convert_row(grey4, 3, pixels.data());
+    CHECK(pixels[0] == RGBA8{ 0, 0, 0, 255 });
+    CHECK(pixels[1] == RGBA8{ 255, 255, 255, 255 });
+    CHECK(pixels[2] == RGBA8{ 136, 136, 136, 255 });
+    // only `width` pixels are written
+    CHECK(pixels[3] == RGBA8{});
+
+    // 16-bit samples keep their high byte
+    const uint8_t rgba16[] = { 0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc, 0xde, 0xf0 };
+    PixelReader(PixelReader::PixelType::RGB_WITH_ALPHA, 16, pallete).convert_row(rgba16, 1, pixels.data());
+    CHECK(pixels[0] == RGBA8{ 0x12, 0x56, 0x9a, 0xde });
+
+    // indices past the pallete are opaque black
+    const uint8_t indices2[] = { 0b01001100 };
+    PixelReader(PixelReader::PixelType::PALLETE, 2, pallete).convert_row(indices2, 4, pixels.data());
+    CHECK(pixels[0] == RGBA8{ 40, 50, 60, 255 });
+    CHECK(pixels[1] == RGBA8{ 10, 20, 30, 255 });
+    CHECK(pixels[2] == RGBA8{ 0, 0, 0, 255 });
+    CHECK(pixels[3] == RGBA8{ 10, 20, 30, 255 });
+
+    // the pallete is looked up in the output format, 16-bit grey scale keeps all its bits
+    std::vector<RGBA16> wide(2);
+    PixelReader(PixelReader::PixelType::PALLETE, 2, pallete, PixelFormat::RGBA16).convert_row(indices2, 2, wide.data());
+    CHECK(wide[0] == RGBA16{ 40 * 257, 50 * 257, 60 * 257, 0xffff });
+    const uint8_t grey16[] = { 0x12, 0x34 };
+    PixelReader(PixelReader::PixelType::GREYSCALE, 16, pallete, PixelFormat::RGBA16).convert_row(grey16, 1, wide.data());
+    CHECK(wide[0] == RGBA16{ 0x1234, 0x1234, 0x1234, 0xffff });
+    std::vector<Gray8> gray(1);
+    PixelReader(PixelReader::PixelType::GREYSCALE, 16, pallete, PixelFormat::GRAY8).convert_row(grey16, 1, gray.data());
+    CHECK(gray[0] == Gray8{ 0x12 });
+    CHECK_THROWS_AS(PixelReader(PixelReader::PixelType::GREYSCALE, 8, pallete, PixelFormat::GRAY8).convert_row(grey16, 1, pixels.data()), error::invalid_arguments);
+
+    CHECK_THROWS_AS(PixelReader(PixelReader::PixelType::RGB, 4, pallete), error::invalid_arguments);
+    CHECK_THROWS_AS(PixelReader(PixelReader::PixelType::PALLETE, 16, pallete), error::invalid_arguments);
+}
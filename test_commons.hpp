@@ -36,10 +36,11 @@ void Compare(const Image& actual, const Image& expected) {
 
 void CheckImage(
     const std::string& filename,
-    std::optional<std::string> output_filename = std::nullopt)
+    std::optional<std::string> output_filename = std::nullopt,
+    const png_decoder::DecoderOptions& options = {})
 {
     std::cerr << "Running " << filename << "\n";
-    auto image = ReadPng(kBasePath + "tests/" + filename);
+    auto image = ReadPng(kBasePath + "tests/" + filename, options);
     if (output_filename.has_value()) {
         libpng::WriteImage(image, output_filename.value());
     }